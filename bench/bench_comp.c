@@ -0,0 +1,100 @@
+/*
+ * bench_comp.c: Samples/second of the compensation kernels on a large
+ * synthetic raw-ADC archive, and bit-exactness against the per-sample API.
+ *
+ * The dataset sweeps realistic ADC ranges (about -40..85 °C, 300..1100 hPa,
+ * 0..100 %RH) for a typical calibration set.
+ *
+ * Usage:
+ *   bench/bench_comp [samples] [passes]     (default 4000000 5)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../libbme280.h"
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = (argc > 1) ? (size_t)atol(argv[1]) : 4000000;
+	int passes = (argc > 2) ? atoi(argv[2]) : 5;
+	if (n == 0) n = 1;
+	if (passes <= 0) passes = 1;
+
+	/* Calibration of a real part (Bosch datasheet example + typical H) */
+	bme280_calib_t calib = {
+		.dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+		.dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+		.dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+		.dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 313, .dig_H5 = 50, .dig_H6 = 30,
+	};
+
+	int32_t  *aT = malloc(n * sizeof *aT), *aP = malloc(n * sizeof *aP), *aH = malloc(n * sizeof *aH);
+	int32_t  *rT = malloc(n * sizeof *rT), *oT = malloc(n * sizeof *oT);
+	uint32_t *rP = malloc(n * sizeof *rP), *oP = malloc(n * sizeof *oP);
+	uint32_t *rH = malloc(n * sizeof *rH), *oH = malloc(n * sizeof *oH);
+	if (!aT || !aP || !aH || !rT || !oT || !rP || !oP || !rH || !oH) {
+		fprintf(stderr, "bench_comp: out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (size_t i = 0; i < n; i++) {
+		aT[i] = 380000 + rand() % 300000;
+		aP[i] = 150000 + rand() % 500000;
+		aH[i] = 15000 + rand() % 40000;
+	}
+
+	printf("bench_comp: %zu samples x %d passes\n", n, passes);
+
+	/* Reference: per-sample API (hidden t_fine state) */
+	double t0 = now_s();
+	for (int p = 0; p < passes; p++) {
+		bme280_calib_t c = calib;
+		for (size_t i = 0; i < n; i++) {
+			bme280_data_t d;
+			bme280_compensate(&c, aT[i], aP[i], aH[i], &d);
+			rT[i] = d.temp; rP[i] = d.press; rH[i] = d.humid;
+		}
+	}
+	double ref = n * passes / (now_s() - t0);
+	printf("%-10s %8.2f Msamples/s\n", "per-sample", ref / 1e6);
+
+	static const int kernels[] = { BME280_KERNEL_SCALAR, BME280_KERNEL_AVX2, BME280_KERNEL_NEON };
+	int rc = 0;
+	for (size_t k = 0; k < sizeof kernels / sizeof kernels[0]; k++) {
+		const char *name = bme280_batch_kernel_name(kernels[k]);
+		if (!bme280_batch_kernel_available(kernels[k])) {
+			printf("%-10s  (not available on this build/CPU)\n", name);
+			continue;
+		}
+		memset(oT, 0, n * sizeof *oT);
+		t0 = now_s();
+		for (int p = 0; p < passes; p++) {
+			bme280_compensate_batch_with(kernels[k], &calib, aT, aP, aH, n, oT, oP, oH);
+		}
+		double rate = n * passes / (now_s() - t0);
+
+		size_t bad = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (oT[i] != rT[i] || oP[i] != rP[i] || oH[i] != rH[i]) bad++;
+		}
+		printf("%-10s %8.2f Msamples/s  (%.2fx)  %s\n", name, rate / 1e6, rate / ref,
+		       bad ? "MISMATCH" : "bit-exact");
+		if (bad) {
+			printf("           %zu/%zu samples differ from the per-sample API\n", bad, n);
+			rc = 1;
+		}
+	}
+	return rc;
+}
@@ -0,0 +1,217 @@
+/*
+ * bench_e2e.c: Latency of one full one-shot cycle, stage by stage, against
+ * the simulated sensor (bme280sim.h) and the mock BP library (mockbp.h).
+ *
+ * Each iteration does what a bpbme280 one-shot run does between start-up
+ * and exit (-nocache, JSON). The sensor stages call the libbme280 steps
+ * sensors_open() and sensors_sample() are made of, in their order; the BP
+ * stages are one bptx_deliver(), split by the per-call deltas of the
+ * histograms it records (metrics.h):
+ *
+ *   open       bme280sim_open()            (open() of the I2C bus)
+ *   chip-id    read register 0xD0
+ *   calib      bme280_read_calib()         (both NVM blocks)
+ *   configure  bme280_configure()
+ *   convert    bme280_trigger_forced() + the datasheet maximum conversion time
+ *   raw        status + data burst, bme280_read_data()
+ *   compensate bme280_parse_raw() + bme280_compensate()
+ *   stats      CPU temperature + load (cpustat)
+ *   json       compose_json()
+ *   sdr        SDR transaction: sdr_malloc() + sdr_write()   (MH_SDR_XN)
+ *   zco        ionCreateZco()                                (MH_ZCO)
+ *   send       bp_send()                                     (MH_SEND)
+ *
+ * and prints p50/p99/max per stage and for the whole cycle. The mock's
+ * MOCKBP_* latencies apply (mockbp.h), so the BP stages can be given a
+ * realistic cost; the sensor stages measure this library plus the
+ * simulator, and "convert" is dominated by the datasheet wait. The last
+ * bundle is checked against the JSON that was composed, and the bundle
+ * count against the cycles.
+ *
+ * Usage:
+ *   bench/bench_e2e [iterations] [device]     (default 500, "sim")
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../bme280sim.h"
+#include "../bptx.h"
+#include "../cpustat.h"
+#include "../libbme280.h"
+#include "../metrics.h"
+#include "../mockbp/mockbp.h"
+#include "../record.h"
+
+enum {
+	ST_OPEN, ST_CHIPID, ST_CALIB, ST_CONFIGURE, ST_CONVERT, ST_RAW, ST_COMPENSATE,
+	ST_STATS, ST_JSON, ST_SDR, ST_ZCO, ST_SEND, ST_TOTAL, ST_COUNT
+};
+
+static const char *stage_name[ST_COUNT] = {
+	"open", "chip-id", "calib", "configure", "convert", "raw", "compensate",
+	"stats", "json", "sdr", "zco", "send", "total",
+};
+
+static int cmp_i64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int64_t hist_ns(metrics_hist_t h)
+{
+	return (int64_t)atomic_load_explicit(&metrics_sum_ns[h], memory_order_relaxed);
+}
+
+/* One cycle; lat[] gets the time of every stage. 0 or -1. */
+static int cycle(const char *dev, const cpustat_t *cs, bptx_t *tx, int64_t *lat,
+                 char *json, size_t json_size, int *json_len)
+{
+	const uint16_t addr = 0x76;
+	const bme280_settings_t st = {
+		.osrs_t = 1, .osrs_p = 1, .osrs_h = 1, .filter = 0, .t_sb = 0, .mode = BME280_MODE_FORCED,
+	};
+	bme280_calib_t calib;
+	uint8_t id = 0, raw[BME280_RAW_LEN];
+	sample_t s;
+	int rc = -1;
+
+	int64_t t = metrics_now(), t0 = t, u;
+#define STAGE(k) do { u = metrics_now(); lat[k] = u - t; t = u; } while (0)
+
+	int fd = bme280sim_open(dev);
+	if (fd < 0) return -1;
+	STAGE(ST_OPEN);
+	if (bme280_read_reg(fd, addr, BME280_REG_ID, &id) < 0 || id != BME280_CHIP_ID) goto out;
+	STAGE(ST_CHIPID);
+	if (bme280_read_calib(fd, addr, &calib) < 0) goto out;
+	STAGE(ST_CALIB);
+	if (bme280_configure(fd, addr, &st) < 0) goto out;
+	STAGE(ST_CONFIGURE);
+	unsigned wait_us = bme280_meas_time_us(&st);
+	if (bme280_trigger_forced(fd, addr, &st) < 0) goto out;
+	usleep(wait_us);
+	STAGE(ST_CONVERT);
+	if (bme280_read_data(fd, addr, wait_us / 8 + 500, wait_us / 8 + 500, raw, NULL) < 0) goto out;
+	STAGE(ST_RAW);
+
+	int32_t adc_T, adc_P, adc_H;
+	bme280_data_t d;
+	bme280_parse_raw(raw, &adc_T, &adc_P, &adc_H);
+	bme280_compensate(&calib, adc_T, adc_P, adc_H, &d);
+	STAGE(ST_COMPENSATE);
+
+	memset(&s, 0, sizeof s);
+	(void)cpustat_temp_mC(cs, &s.cpu_temp);
+	(void)cpustat_load_1min(cs, &s.load);
+	s.ts = time(NULL);
+	STAGE(ST_STATS);
+
+	s.temp = d.temp;
+	s.press = d.press;
+	s.humid = d.humid;
+	*json_len = compose_json(json, json_size, &s, "bench");
+	if (*json_len <= 0) goto out;
+	STAGE(ST_JSON);
+
+	int64_t sdr0 = hist_ns(MH_SDR_XN), zco0 = hist_ns(MH_ZCO), send0 = hist_ns(MH_SEND);
+	if (bptx_deliver(tx, json, *json_len) < 0) goto out;
+	t = metrics_now();
+	lat[ST_SDR] = hist_ns(MH_SDR_XN) - sdr0;
+	lat[ST_ZCO] = hist_ns(MH_ZCO) - zco0;
+	lat[ST_SEND] = hist_ns(MH_SEND) - send0;
+	lat[ST_TOTAL] = t - t0;
+	rc = 0;
+#undef STAGE
+
+out:
+	bme280_close(fd);
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	long n = (argc > 1) ? atol(argv[1]) : 500;
+	const char *dev = (argc > 2) ? argv[2] : BME280SIM_PREFIX;
+	if (n <= 0) n = 1;
+	if (!bme280sim_is_sim(dev)) {
+		fprintf(stderr, "bench_e2e: %s is not a simulator device (sim[:...])\n", dev);
+		return 1;
+	}
+
+	/* Memory mode, a few bundles: enough to check the last one */
+	mockbp_config_t mc;
+	mockbp_config_env(&mc);
+	if (!mc.out_dir) mc.keep = 4;
+	mockbp_configure(&mc);
+
+	int64_t *lat = calloc((size_t)n * ST_COUNT, sizeof *lat);
+	if (!lat) return 1;
+
+	const char *temp_path = CPUSTAT_TEMP_PATH;
+	char tmp[] = "/tmp/bench_e2e.XXXXXX";
+	if (access(temp_path, R_OK) != 0) {
+		int fd = mkstemp(tmp);
+		if (fd < 0 || write(fd, "51375\n", 6) != 6) {
+			perror("mkstemp");
+			return 1;
+		}
+		close(fd);
+		temp_path = tmp;
+	}
+	cpustat_t cs;
+	cpustat_open_paths(&cs, temp_path, CPUSTAT_LOAD_PATH);
+
+	/* As bpbme280 -nospill: the attendant waits for ZCO space */
+	ReqAttendant attendant;
+	bptx_t tx = { 0, NULL, "ipn:2.1", 300, &attendant, NULL, NULL, 0, 0 };
+	if (bp_attach() < 0 || ionStartAttendant(&attendant) < 0 || bp_open_source("ipn:1.1", &tx.sap, 0) < 0) {
+		fprintf(stderr, "bench_e2e: mock BP attach failed\n");
+		return 1;
+	}
+	tx.sdr = bp_get_sdr();
+
+	printf("bench_e2e: %ld one-shot cycles on %s, forced mode x1 (MOCKBP latencies: xn %u, zco %u, send %u us)\n",
+	       n, dev, mc.xn_us, mc.zco_us, mc.send_us);
+
+	char json[512];
+	int json_len = 0;
+	for (long i = 0; i < n; i++) {
+		int64_t row[ST_COUNT];
+		if (cycle(dev, &cs, &tx, row, json, sizeof json, &json_len) < 0) {
+			fprintf(stderr, "bench_e2e: cycle %ld failed\n", i);
+			return 1;
+		}
+		for (int k = 0; k < ST_COUNT; k++) lat[(size_t)k * n + i] = row[k];
+	}
+
+	printf("%-12s %10s %10s %10s\n", "stage", "p50 us", "p99 us", "max us");
+	for (int k = 0; k < ST_COUNT; k++) {
+		int64_t *v = lat + (size_t)k * n;
+		qsort(v, (size_t)n, sizeof *v, cmp_i64);
+		printf("%-12s %10.2f %10.2f %10.2f\n", stage_name[k],
+		       v[(n - 1) * 50 / 100] / 1e3, v[(n - 1) * 99 / 100] / 1e3, v[n - 1] / 1e3);
+	}
+
+	mockbp_stats_t ms;
+	mockbp_bundle_t b;
+	mockbp_get_stats(&ms);
+	int same = mockbp_count() == 0 ||
+	           (mockbp_bundle(mockbp_count() - 1, &b) == 0 &&
+	            b.len == (size_t)json_len && memcmp(b.data, json, b.len) == 0);
+	printf("bundles: %llu sent, %llu bytes; last payload %s\n",
+	       (unsigned long long)ms.bundles, (unsigned long long)ms.bytes, same ? "identical" : "MISMATCH");
+
+	ionStopAttendant(&attendant);
+	bp_close(tx.sap);
+	bp_detach();
+	cpustat_close(&cs);
+	if (temp_path == tmp) unlink(tmp);
+	free(lat);
+	return (same && ms.bundles == (uint64_t)n) ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/*
+ * bench_i2c.c: Register-read paths of libbme280, measured against the
+ * simulated sensor or a real I2C bus, and their bus cost, computed from a
+ * model.
+ *
+ * Measured: the real helpers (I2C_RDWR, repeated start)
+ *
+ *   data         bme280_read_regs()  0xF7..0xFE
+ *   calib        bme280_read_calib() both NVM blocks
+ *   sample/2x    bme280_read_reg(0xF3), then bme280_read_regs(0xF7..0xFE)
+ *   sample/burst bme280_read_data()  0xF3..0xFE in one burst
+ *
+ * with transactions per call from bme280_bus_stats(), and on a real bus
+ * the same reads as plain write() of the register address + read()
+ * ("/split", I2C_SLAVE; the path before I2C_RDWR, two transactions per
+ * read). On the simulator (bme280sim.h) the time is this library plus
+ * the simulator, which stands in for the ioctl: there is no syscall or
+ * bus below it, and that is all split and I2C_RDWR differ in, so the split
+ * path is only measured on hardware and otherwise left to the model.
+ *
+ * Model (computed, not measured): the same reads as plain write()+read()
+ * ("split", the path before I2C_RDWR) and as I2C_RDWR transactions with a
+ * repeated start ("rdwr"), the sample also as one 4-wire SPI transfer.
+ * Bus occupancy is counted in SCL clocks (START/Sr/STOP + 9 clocks per
+ * byte incl. ACK) plus the bus-free time (tBUF) after every STOP, and in
+ * SCK clocks for SPI (8 per byte, no address/ACK overhead).
+ *
+ * Usage:
+ *   bench/bench_i2c [iterations] [device] [addr]   (default 200000, "sim", 0x76)
+ *   e.g. bench/bench_i2c 2000 /dev/i2c-1 0x77
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../bme280sim.h"
+#include "../libbme280.h"
+
+/* ---------------- Measured ---------------- */
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t transactions(void)
+{
+	bme280_bus_stats_t st;
+	bme280_bus_stats(&st);
+	return st.transactions;
+}
+
+static void measured(const char *name, long iters, double t0, uint64_t xfers)
+{
+	printf("%-12s %5.2f xfers  %8.1f ns/op\n", name, (double)xfers / iters, (now_ns() - t0) / iters);
+}
+
+/* Split: the register address as one write(), the data as one read() */
+static uint64_t split_xfers;
+
+static int split_read(int fd, uint8_t reg, uint8_t *buf, size_t len)
+{
+	split_xfers += 2;
+	if (write(fd, &reg, 1) != 1) return -1;
+	return (read(fd, buf, len) == (ssize_t)len) ? 0 : -1;
+}
+
+/* ---------------- Model ---------------- */
+/* One I2C message: (repeated) START, address byte and payload bytes */
+static unsigned msg(size_t len)
+{
+	return 1 + 9 + 9 * (unsigned)len;
+}
+
+static void modeled(const char *name, unsigned syscalls, unsigned xfers, unsigned clk)
+{
+	/* tBUF: 4.7 us (standard mode), 1.3 us (fast mode); + 1 clock per STOP */
+	clk += xfers;
+	printf("%-12s %2u syscalls %2u xfers %4u SCL  %6.1f us@100k %5.1f us@400k\n",
+	       name, syscalls, xfers, clk, clk / 100e3 * 1e6 + xfers * 4.7, clk / 400e3 * 1e6 + xfers * 1.3);
+}
+
+int main(int argc, char **argv)
+{
+	long iters = (argc > 1) ? atol(argv[1]) : 200000;
+	const char *dev = (argc > 2) ? argv[2] : BME280SIM_PREFIX;
+	const uint16_t addr = (argc > 3) ? (uint16_t)strtol(argv[3], NULL, 0) : 0x76;
+	if (iters <= 0) iters = 1;
+
+	int sim = bme280sim_is_sim(dev);
+	int fd = sim ? bme280sim_open(dev) : open(dev, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "bench_i2c: can't open %s: %s\n", dev, strerror(errno));
+		return 1;
+	}
+
+	uint8_t data[BME280_RAW_LEN], status = 0;
+	bme280_calib_t calib;
+	unsigned sink = 0;
+	uint64_t x0;
+	double t0;
+
+	printf("bench_i2c: %ld iterations, libbme280 on %s@0x%02X (measured)\n", iters, dev, addr);
+
+	x0 = transactions(); t0 = now_ns();
+	for (long i = 0; i < iters; i++) {
+		if (bme280_read_regs(fd, addr, BME280_REG_PRESS_MSB, data, sizeof data) < 0) goto fail;
+		sink += data[i & 7];
+	}
+	measured("data", iters, t0, transactions() - x0);
+
+	x0 = transactions(); t0 = now_ns();
+	for (long i = 0; i < iters; i++) {
+		if (bme280_read_calib(fd, addr, &calib) < 0) goto fail;
+		sink += calib.dig_H1;
+	}
+	measured("calib", iters, t0, transactions() - x0);
+
+	x0 = transactions(); t0 = now_ns();
+	for (long i = 0; i < iters; i++) {
+		if (bme280_read_reg(fd, addr, BME280_REG_STATUS, &status) < 0 ||
+		    bme280_read_regs(fd, addr, BME280_REG_PRESS_MSB, data, sizeof data) < 0) goto fail;
+		sink += status + data[i & 7];
+	}
+	measured("sample/2x", iters, t0, transactions() - x0);
+
+	/* Asleep after reset: never measuring, so one burst per call */
+	x0 = transactions(); t0 = now_ns();
+	for (long i = 0; i < iters; i++) {
+		if (bme280_read_data(fd, addr, 0, 0, data, &status) < 0) goto fail;
+		sink += status + data[i & 7];
+	}
+	measured("sample/burst", iters, t0, transactions() - x0);
+
+	if (sim) {
+		printf("(split write()+read(): no syscalls below the simulator; see the model)\n");
+	} else if (ioctl(fd, I2C_SLAVE, addr) < 0) {
+		printf("(split write()+read(): I2C_SLAVE 0x%02X: %s)\n", addr, strerror(errno));
+	} else {
+		x0 = split_xfers; t0 = now_ns();
+		for (long i = 0; i < iters; i++) {
+			if (split_read(fd, BME280_REG_PRESS_MSB, data, sizeof data) < 0) goto fail;
+			sink += data[i & 7];
+		}
+		measured("data/split", iters, t0, split_xfers - x0);
+
+		uint8_t nvm[BME280_CALIB_LEN];
+		x0 = split_xfers; t0 = now_ns();
+		for (long i = 0; i < iters; i++) {
+			if (split_read(fd, BME280_CALIB00, nvm, BME280_CALIB00_LEN) < 0 ||
+			    split_read(fd, BME280_CALIB26, nvm + BME280_CALIB00_LEN, BME280_CALIB26_LEN) < 0) goto fail;
+			sink += nvm[i & 7];
+		}
+		measured("calib/split", iters, t0, split_xfers - x0);
+
+		x0 = split_xfers; t0 = now_ns();
+		for (long i = 0; i < iters; i++) {
+			if (split_read(fd, BME280_REG_STATUS, &status, 1) < 0 ||
+			    split_read(fd, BME280_REG_PRESS_MSB, data, sizeof data) < 0) goto fail;
+			sink += status + data[i & 7];
+		}
+		measured("sample/split", iters, t0, split_xfers - x0);
+	}
+	bme280_close(fd);
+
+	printf("\nbus time per call (model, computed, not measured)\n");
+	modeled("data/split",   2, 2, msg(1) + msg(BME280_RAW_LEN));
+	modeled("data/rdwr",    1, 1, msg(1) + msg(BME280_RAW_LEN));
+	modeled("calib/split",  4, 4, msg(1) + msg(BME280_CALIB00_LEN) + msg(1) + msg(BME280_CALIB26_LEN));
+	modeled("calib/rdwr",   1, 1, msg(1) + msg(BME280_CALIB00_LEN) + msg(1) + msg(BME280_CALIB26_LEN));
+	modeled("sample/2x",    2, 2, msg(1) + msg(1) + msg(1) + msg(BME280_RAW_LEN));
+	modeled("sample/burst", 1, 1, msg(1) + msg(BME280_BURST_LEN));
+	unsigned sck = 8 * (1 + BME280_BURST_LEN);
+	printf("%-12s %2u syscalls %2u xfers %4u SCK  %6.1f us@10M\n", "sample/spi", 1u, 1u, sck, sck / 10e6 * 1e6);
+
+	return (int)(sink & 0);
+
+fail:
+	fprintf(stderr, "bench_i2c: register read failed\n");
+	bme280_close(fd);
+	return 1;
+}
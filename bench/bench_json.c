@@ -0,0 +1,91 @@
+/*
+ * bench_json.c: ns/record of compose_json() (fixed-point writer) against
+ * the previous snprintf("%.1f") path on doubles.
+ *
+ * Samples sweep realistic ranges so every digit-length case is hit. Texts
+ * are compared and differences counted: the integer path rounds half away
+ * from zero, snprintf rounds the binary double (ties-to-even), so exact
+ * .x5 ties can differ in the last digit.
+ *
+ * Usage:
+ *   bench/bench_json [records]     (default 1000000)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../record.h"
+
+#define NSAMPLES 4096
+
+/* The snprintf path as it was before the fixed-point writer */
+static int compose_json_snprintf(char *buf, size_t buflen, const sample_t *s, const char *location)
+{
+	double tC = s->temp / 100.0;
+	double pH = s->press / 25600.0;
+	double hR = s->humid / 1024.0;
+	double cpuC = s->cpu_temp / 1000.0;
+	double l1 = s->load / 100.0;
+	int n;
+	if (location && location[0] != '\0') {
+		n = snprintf(buf, buflen,
+			"{\"ts\":%ld,\"temp\":%.1f,\"press\":%.1f,\"humid\":%.1f,\"cpu_temp\":%.1f,\"load\":%.2f,\"loc\":\"%s\"}",
+			(long)s->ts, tC, pH, hR, cpuC, l1, location);
+	} else {
+		n = snprintf(buf, buflen,
+			"{\"ts\":%ld,\"temp\":%.1f,\"press\":%.1f,\"humid\":%.1f,\"cpu_temp\":%.1f,\"load\":%.2f}",
+			(long)s->ts, tC, pH, hR, cpuC, l1);
+	}
+	return (n > 0 && (size_t)n < buflen) ? n : -1;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	long iters = (argc > 1) ? atol(argv[1]) : 1000000;
+	if (iters <= 0) iters = 1;
+
+	static sample_t smp[NSAMPLES];
+	srand(42);
+	for (int i = 0; i < NSAMPLES; i++) {
+		smp[i].ts = 1758074993 + i;
+		smp[i].temp = -2000 + rand() % 6500;                  /* -20.00 .. 45.00 °C */
+		smp[i].press = (uint32_t)(90000 + rand() % 20000) * 256 + rand() % 256;
+		smp[i].humid = (uint32_t)(rand() % (100 * 1024));
+		smp[i].cpu_temp = 30000 + rand() % 50000;
+		smp[i].load = rand() % 400;
+	}
+
+	char a[256], b[256];
+	long diffs = 0;
+	for (int i = 0; i < NSAMPLES; i++) {
+		compose_json(a, sizeof a, &smp[i], "TestLab");
+		compose_json_snprintf(b, sizeof b, &smp[i], "TestLab");
+		if (strcmp(a, b) != 0) diffs++;
+	}
+
+	size_t sink = 0;
+	double t0 = now_ns();
+	for (long i = 0; i < iters; i++) sink += compose_json_snprintf(b, sizeof b, &smp[i & (NSAMPLES - 1)], "TestLab");
+	double t_snp = (now_ns() - t0) / iters;
+
+	t0 = now_ns();
+	for (long i = 0; i < iters; i++) sink += compose_json(a, sizeof a, &smp[i & (NSAMPLES - 1)], "TestLab");
+	double t_fix = (now_ns() - t0) / iters;
+
+	printf("bench_json: %ld records\n", iters);
+	printf("snprintf     %7.1f ns/record\n", t_snp);
+	printf("fixed-point  %7.1f ns/record  (%.1fx)\n", t_fix, t_snp / t_fix);
+	printf("example      %s\n", a);
+	printf("text differs from snprintf in %ld/%d samples (rounding ties)\n", diffs, NSAMPLES);
+	return (int)(sink & 0);
+}
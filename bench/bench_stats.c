@@ -0,0 +1,102 @@
+/*
+ * bench_stats.c: Per-sample cost of reading CPU temperature + load average,
+ * fopen/fscanf/fclose on every call (the previous path) against cpustat's
+ * persistent descriptors with pread() and the integer scanner.
+ *
+ * Both paths read the same files and must return identical values. Hosts
+ * without a thermal zone (containers, CI) use a temporary stand-in file.
+ *
+ * Usage:
+ *   bench/bench_stats [iterations]     (default 200000)
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../cpustat.h"
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The stdio path as it was before cpustat */
+static int read_cpu_temp_mC(const char *path, int32_t *outmC)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) return -1;
+	long mC = 0;
+	if (fscanf(f, "%ld", &mC) != 1) { fclose(f); return -1; }
+	fclose(f);
+	*outmC = (int32_t)mC;
+	return 0;
+}
+
+static int read_cpu_load_1min(const char *path, int32_t *outLoad)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) return -1;
+	double l1 = 0.0;
+	if (fscanf(f, "%lf", &l1) != 1) { fclose(f); return -1; }
+	fclose(f);
+	*outLoad = (int32_t)lround(l1 * 100.0);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long n = (argc > 1) ? atol(argv[1]) : 200000;
+	if (n <= 0) n = 1;
+
+	const char *temp_path = CPUSTAT_TEMP_PATH;
+	char tmp[] = "/tmp/bench_stats.XXXXXX";
+	if (access(temp_path, R_OK) != 0) {
+		int fd = mkstemp(tmp);
+		if (fd < 0 || write(fd, "51375\n", 6) != 6) {
+			perror("mkstemp");
+			return 1;
+		}
+		close(fd);
+		temp_path = tmp;
+		printf("bench_stats: no thermal zone, using %s\n", tmp);
+	}
+
+	printf("bench_stats: %ld samples (temp + load each)\n", n);
+
+	int32_t t_ref = 0, l_ref = 0, t = 0, l = 0;
+	double t0 = now_s();
+	for (long i = 0; i < n; i++) {
+		(void)read_cpu_temp_mC(temp_path, &t_ref);
+		(void)read_cpu_load_1min(CPUSTAT_LOAD_PATH, &l_ref);
+	}
+	double ref = (now_s() - t0) / n;
+	printf("%-14s %8.0f ns/sample\n", "fopen/fscanf", ref * 1e9);
+
+	cpustat_t cs;
+	cpustat_open_paths(&cs, temp_path, CPUSTAT_LOAD_PATH);
+	t0 = now_s();
+	for (long i = 0; i < n; i++) {
+		(void)cpustat_temp_mC(&cs, &t);
+		(void)cpustat_load_1min(&cs, &l);
+	}
+	double fast = (now_s() - t0) / n;
+	printf("%-14s %8.0f ns/sample  (%.1fx)\n", "pread", fast * 1e9, ref / fast);
+
+	/* Load can tick between the two loops; compare one fresh pair */
+	(void)read_cpu_temp_mC(temp_path, &t_ref);
+	(void)read_cpu_load_1min(CPUSTAT_LOAD_PATH, &l_ref);
+	(void)cpustat_temp_mC(&cs, &t);
+	(void)cpustat_load_1min(&cs, &l);
+	cpustat_close(&cs);
+	if (temp_path == tmp) unlink(tmp);
+
+	int same = (t == t_ref && l == l_ref);
+	printf("values: temp %d m°C, load %d/100  %s\n", t, l, same ? "identical" : "MISMATCH");
+	return same ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/*
+ * bme280_batch.c: Structure-of-arrays batch compensation (see libbme280.h).
+ *
+ * Temperature (t_fine) and humidity are pure int32 arithmetic: multiplies
+ * that wrap, arithmetic right shifts and a clamp. They map one-to-one onto
+ * AVX2 (8 lanes) and NEON (4 lanes) and are bit-exact with the scalar
+ * datasheet code. Pressure needs 64-bit multiplies and a 64-bit division,
+ * which neither instruction set has, so every kernel runs it as a scalar
+ * loop over the t_fine values the vector pass produced.
+ *
+ * The AVX2 kernel is compiled with a per-function target attribute and
+ * selected at run time, so the library itself needs no -mavx2.
+ */
+
+#include "bme280_comp.h"
+#include "libbme280.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNEL 1
+#endif
+
+/* Samples per pass: t_fine lives on the stack between the T/H and P loops */
+#define CHUNK 256
+
+/* ---------------- Scalar ---------------- */
+static void th_scalar(const bme280_calib_t *c, const int32_t *adc_T, const int32_t *adc_H,
+                      size_t n, int32_t *temp, uint32_t *humid, int32_t *t_fine)
+{
+	for (size_t i = 0; i < n; i++) {
+		int32_t tf = bme280_k_t_fine(adc_T[i], c);
+		t_fine[i] = tf;
+		temp[i] = bme280_k_T(tf);
+		humid[i] = bme280_k_H(adc_H[i], tf, c);
+	}
+}
+
+/* ---------------- AVX2 ---------------- */
+#ifdef HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+static void th_avx2(const bme280_calib_t *c, const int32_t *adc_T, const int32_t *adc_H,
+                    size_t n, int32_t *temp, uint32_t *humid, int32_t *t_fine)
+{
+	const __m256i T1   = _mm256_set1_epi32(c->dig_T1);
+	const __m256i T1x2 = _mm256_set1_epi32((int32_t)c->dig_T1 << 1);
+	const __m256i T2   = _mm256_set1_epi32(c->dig_T2);
+	const __m256i T3   = _mm256_set1_epi32(c->dig_T3);
+	const __m256i H1   = _mm256_set1_epi32(c->dig_H1);
+	const __m256i H2   = _mm256_set1_epi32(c->dig_H2);
+	const __m256i H3   = _mm256_set1_epi32(c->dig_H3);
+	const __m256i H4s  = _mm256_set1_epi32((int32_t)c->dig_H4 << 20);
+	const __m256i H5   = _mm256_set1_epi32(c->dig_H5);
+	const __m256i H6   = _mm256_set1_epi32(c->dig_H6);
+	const __m256i k5   = _mm256_set1_epi32(5);
+	const __m256i k128 = _mm256_set1_epi32(128);
+	const __m256i k76800   = _mm256_set1_epi32(76800);
+	const __m256i k16384   = _mm256_set1_epi32(16384);
+	const __m256i k32768   = _mm256_set1_epi32(32768);
+	const __m256i k2097152 = _mm256_set1_epi32(2097152);
+	const __m256i k8192    = _mm256_set1_epi32(8192);
+	const __m256i hmax     = _mm256_set1_epi32(419430400);
+	const __m256i zero     = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i aT = _mm256_loadu_si256((const __m256i *)(adc_T + i));
+		__m256i aH = _mm256_loadu_si256((const __m256i *)(adc_H + i));
+
+		/* t_fine */
+		__m256i v1 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(_mm256_srai_epi32(aT, 3), T1x2), T2), 11);
+		__m256i d  = _mm256_sub_epi32(_mm256_srai_epi32(aT, 4), T1);
+		__m256i v2 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(d, d), 12), T3), 14);
+		__m256i tf = _mm256_add_epi32(v1, v2);
+		_mm256_storeu_si256((__m256i *)(t_fine + i), tf);
+		_mm256_storeu_si256((__m256i *)(temp + i),
+		                    _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(tf, k5), k128), 8));
+
+		/* humidity */
+		__m256i x = _mm256_sub_epi32(tf, k76800);
+		__m256i a = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_slli_epi32(aH, 14), H4s), _mm256_mullo_epi32(H5, x));
+		a = _mm256_srai_epi32(_mm256_add_epi32(a, k16384), 15);
+		__m256i b6 = _mm256_srai_epi32(_mm256_mullo_epi32(x, H6), 10);
+		__m256i b3 = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(x, H3), 11), k32768);
+		__m256i b  = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(b6, b3), 10), k2097152);
+		b = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(b, H2), k8192), 14);
+		__m256i v = _mm256_mullo_epi32(a, b);
+		__m256i v15 = _mm256_srai_epi32(v, 15);
+		v = _mm256_sub_epi32(v, _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(v15, v15), 7), H1), 4));
+		v = _mm256_min_epi32(_mm256_max_epi32(v, zero), hmax);
+		_mm256_storeu_si256((__m256i *)(humid + i), _mm256_srai_epi32(v, 12));
+	}
+	th_scalar(c, adc_T + i, adc_H + i, n - i, temp + i, humid + i, t_fine + i);
+}
+#endif
+
+/* ---------------- NEON ---------------- */
+#ifdef HAVE_NEON_KERNEL
+static void th_neon(const bme280_calib_t *c, const int32_t *adc_T, const int32_t *adc_H,
+                    size_t n, int32_t *temp, uint32_t *humid, int32_t *t_fine)
+{
+	const int32x4_t T1   = vdupq_n_s32(c->dig_T1);
+	const int32x4_t T1x2 = vdupq_n_s32((int32_t)c->dig_T1 << 1);
+	const int32x4_t T2   = vdupq_n_s32(c->dig_T2);
+	const int32x4_t T3   = vdupq_n_s32(c->dig_T3);
+	const int32x4_t H1   = vdupq_n_s32(c->dig_H1);
+	const int32x4_t H2   = vdupq_n_s32(c->dig_H2);
+	const int32x4_t H3   = vdupq_n_s32(c->dig_H3);
+	const int32x4_t H4s  = vdupq_n_s32((int32_t)c->dig_H4 << 20);
+	const int32x4_t H5   = vdupq_n_s32(c->dig_H5);
+	const int32x4_t H6   = vdupq_n_s32(c->dig_H6);
+	const int32x4_t k128 = vdupq_n_s32(128);
+	const int32x4_t k76800   = vdupq_n_s32(76800);
+	const int32x4_t k16384   = vdupq_n_s32(16384);
+	const int32x4_t k32768   = vdupq_n_s32(32768);
+	const int32x4_t k2097152 = vdupq_n_s32(2097152);
+	const int32x4_t k8192    = vdupq_n_s32(8192);
+	const int32x4_t hmax     = vdupq_n_s32(419430400);
+	const int32x4_t zero     = vdupq_n_s32(0);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		int32x4_t aT = vld1q_s32(adc_T + i);
+		int32x4_t aH = vld1q_s32(adc_H + i);
+
+		/* t_fine */
+		int32x4_t v1 = vshrq_n_s32(vmulq_s32(vsubq_s32(vshrq_n_s32(aT, 3), T1x2), T2), 11);
+		int32x4_t d  = vsubq_s32(vshrq_n_s32(aT, 4), T1);
+		int32x4_t v2 = vshrq_n_s32(vmulq_s32(vshrq_n_s32(vmulq_s32(d, d), 12), T3), 14);
+		int32x4_t tf = vaddq_s32(v1, v2);
+		vst1q_s32(t_fine + i, tf);
+		vst1q_s32(temp + i, vshrq_n_s32(vaddq_s32(vmulq_n_s32(tf, 5), k128), 8));
+
+		/* humidity */
+		int32x4_t x = vsubq_s32(tf, k76800);
+		int32x4_t a = vsubq_s32(vsubq_s32(vshlq_n_s32(aH, 14), H4s), vmulq_s32(H5, x));
+		a = vshrq_n_s32(vaddq_s32(a, k16384), 15);
+		int32x4_t b6 = vshrq_n_s32(vmulq_s32(x, H6), 10);
+		int32x4_t b3 = vaddq_s32(vshrq_n_s32(vmulq_s32(x, H3), 11), k32768);
+		int32x4_t b  = vaddq_s32(vshrq_n_s32(vmulq_s32(b6, b3), 10), k2097152);
+		b = vshrq_n_s32(vaddq_s32(vmulq_s32(b, H2), k8192), 14);
+		int32x4_t v = vmulq_s32(a, b);
+		int32x4_t v15 = vshrq_n_s32(v, 15);
+		v = vsubq_s32(v, vshrq_n_s32(vmulq_s32(vshrq_n_s32(vmulq_s32(v15, v15), 7), H1), 4));
+		v = vminq_s32(vmaxq_s32(v, zero), hmax);
+		vst1q_u32(humid + i, vreinterpretq_u32_s32(vshrq_n_s32(v, 12)));
+	}
+	th_scalar(c, adc_T + i, adc_H + i, n - i, temp + i, humid + i, t_fine + i);
+}
+#endif
+
+/* ---------------- Dispatch ---------------- */
+typedef void (*th_kernel_t)(const bme280_calib_t *, const int32_t *, const int32_t *,
+                            size_t, int32_t *, uint32_t *, int32_t *);
+
+int bme280_batch_kernel_available(int kernel)
+{
+	switch (kernel) {
+	case BME280_KERNEL_AUTO:
+	case BME280_KERNEL_SCALAR:
+		return 1;
+#ifdef HAVE_AVX2_KERNEL
+	case BME280_KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_NEON_KERNEL
+	case BME280_KERNEL_NEON:
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+}
+
+const char *bme280_batch_kernel_name(int kernel)
+{
+	switch (kernel) {
+	case BME280_KERNEL_AUTO:   return "auto";
+	case BME280_KERNEL_SCALAR: return "scalar";
+	case BME280_KERNEL_AVX2:   return "avx2";
+	case BME280_KERNEL_NEON:   return "neon";
+	default:                   return "unknown";
+	}
+}
+
+static th_kernel_t th_kernel(int kernel)
+{
+	if (kernel == BME280_KERNEL_AUTO) {
+		if (bme280_batch_kernel_available(BME280_KERNEL_AVX2)) kernel = BME280_KERNEL_AVX2;
+		else if (bme280_batch_kernel_available(BME280_KERNEL_NEON)) kernel = BME280_KERNEL_NEON;
+		else kernel = BME280_KERNEL_SCALAR;
+	}
+	if (!bme280_batch_kernel_available(kernel)) return NULL;
+	switch (kernel) {
+#ifdef HAVE_AVX2_KERNEL
+	case BME280_KERNEL_AVX2: return th_avx2;
+#endif
+#ifdef HAVE_NEON_KERNEL
+	case BME280_KERNEL_NEON: return th_neon;
+#endif
+	default:                 return th_scalar;
+	}
+}
+
+int bme280_compensate_batch_with(int kernel, const bme280_calib_t *c,
+                                 const int32_t *adc_T, const int32_t *adc_P, const int32_t *adc_H,
+                                 size_t n, int32_t *temp, uint32_t *press, uint32_t *humid)
+{
+	th_kernel_t th = th_kernel(kernel);
+	if (!th) return -1;
+
+	int32_t t_fine[CHUNK];
+	for (size_t off = 0; off < n; off += CHUNK) {
+		size_t m = (n - off < CHUNK) ? n - off : CHUNK;
+		th(c, adc_T + off, adc_H + off, m, temp + off, humid + off, t_fine);
+		for (size_t i = 0; i < m; i++) {
+			press[off + i] = bme280_k_P(adc_P[off + i], t_fine[i], c);
+		}
+	}
+	return 0;
+}
+
+void bme280_compensate_batch(const bme280_calib_t *c,
+                             const int32_t *adc_T, const int32_t *adc_P, const int32_t *adc_H,
+                             size_t n, int32_t *temp, uint32_t *press, uint32_t *humid)
+{
+	(void)bme280_compensate_batch_with(BME280_KERNEL_AUTO, c, adc_T, adc_P, adc_H,
+	                                   n, temp, press, humid);
+}
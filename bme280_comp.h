@@ -0,0 +1,59 @@
+/*
+ * bme280_comp.h: Datasheet compensation kernels with explicit t_fine
+ * (internal to libbme280; the public API is in libbme280.h).
+ *
+ * These are the single copy of the Bosch integer formulas. The per-sample
+ * API and the scalar paths of the batch kernels both inline them, and the
+ * SIMD kernels are checked bit-exact against them.
+ */
+#ifndef BME280_COMP_H
+#define BME280_COMP_H
+
+#include <stdint.h>
+
+#include "libbme280.h"
+
+static inline int32_t bme280_k_t_fine(int32_t adc_T, const bme280_calib_t *c)
+{
+	int32_t var1 = ((((adc_T >> 3) - ((int32_t)c->dig_T1 << 1))) * ((int32_t)c->dig_T2)) >> 11;
+	int32_t var2 = (((((adc_T >> 4) - ((int32_t)c->dig_T1)) * ((adc_T >> 4) - ((int32_t)c->dig_T1))) >> 12) *
+	               ((int32_t)c->dig_T3)) >> 14;
+	return var1 + var2;
+}
+
+static inline int32_t bme280_k_T(int32_t t_fine)
+{
+	return (t_fine * 5 + 128) >> 8;
+}
+
+static inline uint32_t bme280_k_P(int32_t adc_P, int32_t t_fine, const bme280_calib_t *c)
+{
+	int64_t var1 = ((int64_t)t_fine) - 128000;
+	int64_t var2 = var1 * var1 * (int64_t)c->dig_P6;
+	var2 = var2 + ((var1 * (int64_t)c->dig_P5) << 17);
+	var2 = var2 + (((int64_t)c->dig_P4) << 35);
+	var1 = ((var1 * var1 * (int64_t)c->dig_P3) >> 8) + ((var1 * (int64_t)c->dig_P2) << 12);
+	var1 = (((((int64_t)1) << 47) + var1) * ((int64_t)c->dig_P1)) >> 33;
+	if (var1 == 0) return 0;  /* avoid division by zero */
+
+	int64_t p = 1048576 - adc_P;
+	p = (((p << 31) - var2) * 3125) / var1;
+	var1 = (((int64_t)c->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (((int64_t)c->dig_P8) * p) >> 19;
+	p = ((p + var1 + var2) >> 8) + (((int64_t)c->dig_P7) << 4);
+	return (uint32_t)p;
+}
+
+static inline uint32_t bme280_k_H(int32_t adc_H, int32_t t_fine, const bme280_calib_t *c)
+{
+	int32_t x = t_fine - 76800;
+	int32_t v = (((((adc_H << 14) - (((int32_t)c->dig_H4) << 20) - ((int32_t)c->dig_H5 * x)) + 16384) >> 15) *
+	             (((((((x * (int32_t)c->dig_H6) >> 10) * (((x * (int32_t)c->dig_H3) >> 11) + 32768)) >> 10) + 2097152) *
+	               (int32_t)c->dig_H2 + 8192) >> 14));
+	v = v - (((((v >> 15) * (v >> 15)) >> 7) * (int32_t)c->dig_H1) >> 4);
+	if (v < 0) v = 0;
+	if (v > 419430400) v = 419430400;
+	return (uint32_t)(v >> 12);
+}
+
+#endif /* BME280_COMP_H */
@@ -0,0 +1,155 @@
+/*
+ * bme280rx.c: Receiver-side decoding and compensation (see bme280rx.h).
+ */
+
+#include <string.h>
+
+#include "bme280rx.h"
+#include "cbor.h"
+
+#define HAVE(k)       (1 << (k))
+#define HAVE_COMP     (HAVE(REC_KEY_TS) | HAVE(REC_KEY_TEMP) | HAVE(REC_KEY_PRESS) | \
+                       HAVE(REC_KEY_HUMID) | HAVE(REC_KEY_CPU_TEMP) | HAVE(REC_KEY_LOAD))
+#define HAVE_SUM      (HAVE(REC_KEY_TS) | HAVE(REC_KEY_N) | HAVE(REC_KEY_SPAN) | HAVE(REC_KEY_TEMP) | \
+                       HAVE(REC_KEY_PRESS) | HAVE(REC_KEY_HUMID) | HAVE(REC_KEY_CPU_TEMP) | HAVE(REC_KEY_LOAD))
+#define HAVE_RAW      (HAVE(REC_KEY_TS) | HAVE(REC_KEY_RAW) | HAVE(REC_KEY_CPU_TEMP) | \
+                       HAVE(REC_KEY_LOAD))
+
+void bme280rx_init(bme280rx_t *rx)
+{
+	memset(rx, 0, sizeof *rx);
+}
+
+int bme280rx_set_calib(bme280rx_t *rx, int32_t sid, const uint8_t *calib_raw)
+{
+	if (sid < 0 || sid > BME280RX_MAX_SID) return -1;
+	bme280rx_calib_t *cal = &rx->cal[sid];
+	memcpy(cal->raw, calib_raw, BME280_CALIB_LEN);
+	bme280_parse_calib(calib_raw, calib_raw + BME280_CALIB00_LEN, &cal->calib);
+	cal->have = 1;
+	return 0;
+}
+
+/* One map. Returns 1 with *rec filled, 0 for a calibration-only map, or
+ * BME280RX_ERR_* */
+static int decode_map(bme280rx_t *rx, cbor_reader_t *r, bme280rx_rec_t *rec)
+{
+	uint64_t n;
+	if (cbor_get_head(r, &n, NULL) != CBOR_MAP) return BME280RX_ERR_FORMAT;
+
+	int64_t v[REC_KEY_LOC] = {0};
+	int64_t sid = 0;
+	int64_t ms = -1;
+	const uint8_t *calib = NULL;
+	int have = 0;
+	memset(rec, 0, sizeof *rec);
+
+	while (n-- && !r->err) {
+		int64_t key;
+		const uint8_t *b;
+		size_t len;
+		if (cbor_get_int(r, &key) < 0) return BME280RX_ERR_FORMAT;
+		if (key > REC_KEY_TS && key < REC_KEY_LOC && r->p < r->end && (*r->p >> 5) == CBOR_ARRAY) {
+			/* Summary statistics */
+			uint64_t na;
+			if (cbor_get_head(r, &na, NULL) != CBOR_ARRAY || na != REC_SUM_STATS) return BME280RX_ERR_FORMAT;
+			for (int i = 0; i < REC_SUM_STATS; i++) {
+				if (cbor_get_int(r, &rec->sum.v[key][i]) < 0) return BME280RX_ERR_FORMAT;
+			}
+		} else if (key >= 0 && key < REC_KEY_LOC) {
+			if (cbor_get_int(r, &v[key]) < 0) return BME280RX_ERR_FORMAT;
+		} else if (key == REC_KEY_N || key == REC_KEY_SPAN) {
+			int64_t x;
+			if (cbor_get_int(r, &x) < 0 || x < 0 || x > INT32_MAX) return BME280RX_ERR_FORMAT;
+			if (key == REC_KEY_N) rec->sum.n = (uint32_t)x;
+			else                  rec->sum.span = (int32_t)x;
+		} else if (key == REC_KEY_LOC) {
+			if (cbor_get_text(r, &rec->loc, &rec->loc_len) < 0) return BME280RX_ERR_FORMAT;
+		} else if (key == REC_KEY_RAW) {
+			if (cbor_get_bytes(r, &b, &len) < 0 || len != BME280_RAW_LEN) return BME280RX_ERR_FORMAT;
+			memcpy(rec->adc, b, BME280_RAW_LEN);
+		} else if (key == REC_KEY_CALIB) {
+			if (cbor_get_bytes(r, &calib, &len) < 0 || len != BME280_CALIB_LEN) return BME280RX_ERR_FORMAT;
+		} else if (key == REC_KEY_MS) {
+			if (cbor_get_int(r, &ms) < 0 || ms < 0 || ms > 999) return BME280RX_ERR_FORMAT;
+		} else if (key == REC_KEY_SID) {
+			if (cbor_get_int(r, &sid) < 0 || sid < 0 || sid > BME280RX_MAX_SID) return BME280RX_ERR_FORMAT;
+		} else {
+			cbor_skip(r);                 /* unknown key: ignore */
+			continue;
+		}
+		have |= HAVE(key);
+	}
+	if (r->err) return BME280RX_ERR_FORMAT;
+
+	if (calib) {
+		(void)bme280rx_set_calib(rx, (int32_t)sid, calib);
+		rx->calib_updated = 1;
+	}
+	if ((have & ~(HAVE(REC_KEY_CALIB) | HAVE(REC_KEY_SID))) == 0 && calib) return 0;
+	if (have & HAVE(REC_KEY_N)) {
+		if ((have & HAVE_SUM) != HAVE_SUM) return BME280RX_ERR_FORMAT;
+		rec->sum.ts = v[REC_KEY_TS];
+		rec->sum.sid = (int32_t)sid;
+		rec->summary = 1;
+		return 1;
+	}
+	if ((have & HAVE_COMP) == HAVE_COMP) {
+		rec_from_wire(v, &rec->s);
+		rec->s.sid = (int32_t)sid;
+		if (ms >= 0) rec->s.ts_ms = rec->s.ts * 1000 + ms;
+		return 1;
+	}
+	if ((have & HAVE_RAW) != HAVE_RAW) return BME280RX_ERR_FORMAT;
+	if (!rx->cal[sid].have) return BME280RX_ERR_NOCALIB;
+
+	/* Sensor fields at full precision; the rest from the wire values */
+	int32_t adc_T, adc_P, adc_H;
+	bme280_data_t d;
+	bme280_calib_t c = rx->cal[sid].calib;
+	bme280_parse_raw(rec->adc, &adc_T, &adc_P, &adc_H);
+	bme280_compensate(&c, adc_T, adc_P, adc_H, &d);
+	rec_from_wire(v, &rec->s);
+	rec->s.sid   = (int32_t)sid;
+	if (ms >= 0) rec->s.ts_ms = rec->s.ts * 1000 + ms;
+	rec->s.temp  = d.temp;
+	rec->s.press = d.press;
+	rec->s.humid = d.humid;
+	rec->raw = 1;
+	return 1;
+}
+
+int bme280rx_decode(bme280rx_t *rx, const uint8_t *buf, size_t len, int *is_batch,
+                    bme280rx_cb cb, void *arg)
+{
+	cbor_reader_t r;
+	bme280rx_rec_t rec;
+	int count = 0, rc;
+
+	if (len == 0) return BME280RX_ERR_FORMAT;
+	cbor_reader_init(&r, buf, len);
+	rx->calib_updated = 0;
+
+	if ((buf[0] >> 5) == CBOR_MAP) {
+		*is_batch = 0;
+		if ((rc = decode_map(rx, &r, &rec)) < 0) return rc;
+		if (rc > 0) {
+			count++;
+			if (cb) (void)cb(&rec, arg);
+		}
+		return count;
+	}
+
+	uint64_t n;
+	int indef;
+	if (cbor_get_head(&r, &n, &indef) != CBOR_ARRAY) return BME280RX_ERR_FORMAT;
+	*is_batch = 1;
+	for (uint64_t i = 0; indef || i < n; i++) {
+		if (indef && r.p < r.end && *r.p == CBOR_BREAK) { r.p++; break; }
+		if ((rc = decode_map(rx, &r, &rec)) < 0) return rc;
+		if (rc == 0) continue;
+		count++;
+		if (cb && cb(&rec, arg) != 0) break;
+	}
+	return r.err ? BME280RX_ERR_FORMAT : count;
+}
@@ -0,0 +1,58 @@
+/*
+ * bme280rx.h: Receiver-side decoding of bpbme280 payloads.
+ *
+ * Turns any bpbme280 CBOR payload (compensated or raw, single record or
+ * batch, see record.h) back into sample_t records. Raw records are
+ * compensated here with libbme280 using the calibration block carried in
+ * the payload, or one remembered from an earlier payload of the session
+ * (per sensor id); the original ADC bytes are passed along for
+ * archiving/reprocessing. Summary records come back as summary_t.
+ */
+#ifndef BME280RX_H
+#define BME280RX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libbme280.h"
+#include "record.h"
+
+#define BME280RX_ERR_FORMAT  -1     /* malformed payload */
+#define BME280RX_ERR_NOCALIB -2     /* raw record before any calibration */
+
+#define BME280RX_MAX_SID     16
+
+typedef struct {
+	sample_t       s;
+	const char    *loc;             /* into the payload, not NUL-terminated; NULL if absent */
+	size_t         loc_len;
+	int            raw;             /* 1: compensated here from adc[] */
+	uint8_t        adc[BME280_RAW_LEN];
+	int            summary;         /* 1: a summary record, in sum (s unused) */
+	summary_t      sum;
+} bme280rx_rec_t;
+
+typedef struct {
+	int            have;
+	uint8_t        raw[BME280_CALIB_LEN];
+	bme280_calib_t calib;
+} bme280rx_calib_t;
+
+typedef struct {
+	bme280rx_calib_t cal[BME280RX_MAX_SID + 1];   /* by sensor id, 0 = untagged */
+	int              calib_updated;   /* a decoded payload carried calibration */
+} bme280rx_t;
+
+/* Called once per record in payload order; a non-zero return stops decoding */
+typedef int (*bme280rx_cb)(const bme280rx_rec_t *rec, void *arg);
+
+void bme280rx_init(bme280rx_t *rx);
+/* Use a calibration image (BME280_CALIB_LEN bytes) for sensor sid, e.g.
+ * saved from an earlier session; -1 if sid is out of range */
+int  bme280rx_set_calib(bme280rx_t *rx, int32_t sid, const uint8_t *calib_raw);
+/* Decode one payload. *is_batch tells whether it was an array. Returns the
+ * number of records, or BME280RX_ERR_*. */
+int  bme280rx_decode(bme280rx_t *rx, const uint8_t *buf, size_t len, int *is_batch,
+                     bme280rx_cb cb, void *arg);
+
+#endif /* BME280RX_H */
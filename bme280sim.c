@@ -0,0 +1,361 @@
+/*
+ * bme280sim.c: In-process BME280 simulator (see bme280sim.h).
+ *
+ * Time is CLOCK_MONOTONIC and the chip state is advanced lazily, on every
+ * access: a forced conversion completes once its typical time has passed
+ * (then the chip is back in sleep mode), and in normal mode every finished
+ * measurement + standby cycle since the last access is run through the
+ * filter, so a slow reader still sees a settled IIR output.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bme280sim.h"
+
+#define SIM_CHIPS         8           /* slave addresses per bus */
+#define SIM_RESET_NS      2000000     /* NVM copy after power-on/soft reset */
+#define SIM_CATCHUP       64          /* normal-mode cycles run per access, at most */
+#define SIM_SKIPPED_20    0x80000     /* skipped T/P channel */
+#define SIM_SKIPPED_16    0x8000      /* skipped H channel */
+
+/* Datasheet example calibration (section 8.1 and app notes) */
+static const bme280_calib_t sim_calib = {
+	.dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+	.dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+	.dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+	.dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 313, .dig_H5 = 50, .dig_H6 = 30,
+};
+
+typedef struct {
+	uint16_t       addr;
+	uint8_t        regs[256];
+	uint8_t        osrs_h;           /* ctrl_hum as latched by the last ctrl_meas write */
+	int64_t        reset_end;        /* im_update until then */
+	int64_t        start;            /* forced: conversion start; normal: cycle 0 start */
+	int64_t        done;             /* forced: conversion end */
+	uint64_t       cycles;           /* normal: cycles already converted */
+	int            filtered;         /* IIR state valid */
+	double         ft, fp;           /* IIR state, °C and hPa */
+	uint64_t       rng;
+	bme280_calib_t calib;
+} sim_chip_t;
+
+typedef struct {
+	bme280sim_spec_t spec;
+	int64_t          t0;             /* waveform time origin */
+	sim_chip_t       chip[SIM_CHIPS];
+	int              nchip;
+} sim_t;
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* ---------------- Device string ---------------- */
+int bme280sim_is_sim(const char *dev)
+{
+	size_t n = strlen(BME280SIM_PREFIX);
+	return strncmp(dev, BME280SIM_PREFIX, n) == 0 && (dev[n] == '\0' || dev[n] == ':');
+}
+
+static int parse_wave(const char *p, const char **end, bme280sim_wave_t *w)
+{
+	double *f[4] = { &w->base, &w->amp, &w->period, &w->noise };
+	for (int i = 0; i < 4; i++) {
+		char *e;
+		double x = strtod(p, &e);
+		if (e == p || !isfinite(x) || (i > 0 && x < 0) || (i == 2 && x == 0)) return -1;
+		*f[i] = x;
+		p = e;
+		if (*p != '/') break;
+		p++;
+	}
+	*end = p;
+	return 0;
+}
+
+int bme280sim_parse(const char *dev, bme280sim_spec_t *spec)
+{
+	const bme280sim_spec_t dflt = {
+		.t = { 22.5, 0, 60, 0 }, .p = { 1013.25, 0, 60, 0 }, .h = { 45, 0, 60, 0 },
+	};
+
+	*spec = dflt;
+	if (!bme280sim_is_sim(dev)) return -1;
+	const char *p = dev + strlen(BME280SIM_PREFIX);
+	while (*p == ':') {
+		bme280sim_wave_t *w;
+		switch (p[1]) {
+		case 't': w = &spec->t; break;
+		case 'p': w = &spec->p; break;
+		case 'h': w = &spec->h; break;
+		default:  return -1;
+		}
+		if (p[2] != '=' || parse_wave(p + 3, &p, w) < 0) return -1;
+	}
+	return (*p == '\0') ? 0 : -1;
+}
+
+/* ---------------- Conversion ---------------- */
+/* xorshift64*, Box-Muller: deterministic noise */
+static double sim_gauss(sim_chip_t *c)
+{
+	double u[2];
+	for (int i = 0; i < 2; i++) {
+		c->rng ^= c->rng >> 12;
+		c->rng ^= c->rng << 25;
+		c->rng ^= c->rng >> 27;
+		u[i] = ((c->rng * 2685821657736338717ull) >> 11) * (1.0 / 9007199254740992.0);
+	}
+	return sqrt(-2 * log(u[0] + 1e-300)) * cos(2 * M_PI * u[1]);
+}
+
+static double sim_wave(sim_chip_t *c, const bme280sim_wave_t *w, double t, unsigned os)
+{
+	double x = w->base + w->amp * sin(2 * M_PI * t / w->period);
+	return x + w->noise * sim_gauss(c) / sqrt((double)os);
+}
+
+/* The first code in [0, 2^bits) at which comp, increasing or decreasing
+ * in the code, crosses target: its inverse, to one LSB */
+static int32_t sim_invert(sim_chip_t *c, int bits, int increasing, double target,
+                          double (*comp)(sim_chip_t *, int32_t))
+{
+	int32_t lo = 0, hi = (1 << bits) - 1;
+	while (lo < hi) {
+		int32_t mid = lo + (hi - lo) / 2;
+		if ((comp(c, mid) >= target) == increasing) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+static double comp_t(sim_chip_t *c, int32_t adc)
+{
+	return bme280_comp_T(adc, &c->calib);
+}
+
+static double comp_p(sim_chip_t *c, int32_t adc)
+{
+	return bme280_comp_P(adc, &c->calib);
+}
+
+static double comp_h(sim_chip_t *c, int32_t adc)
+{
+	return bme280_comp_H(adc, &c->calib);
+}
+
+/* Oversampling adds one bit per doubling up to 20; the filter gives 20 */
+static int32_t sim_quantize(int32_t adc, unsigned os, int filtered)
+{
+	int bits = 16;
+	for (unsigned f = os; f > 1 && bits < 20; f >>= 1) bits++;
+	if (filtered) bits = 20;
+	return adc & ~((1 << (20 - bits)) - 1);
+}
+
+static void put20(uint8_t *r, int32_t v)
+{
+	r[0] = (uint8_t)(v >> 12);
+	r[1] = (uint8_t)(v >> 4);
+	r[2] = (uint8_t)((v & 0x0F) << 4);
+}
+
+/* One conversion at time t (ns) into the data registers */
+static void sim_convert(sim_t *sim, sim_chip_t *c, int64_t t)
+{
+	uint8_t meas = c->regs[BME280_REG_CTRL_MEAS];
+	unsigned os_t = bme280_osrs_factor(meas >> 5);
+	unsigned os_p = bme280_osrs_factor((meas >> 2) & 0x07);
+	unsigned os_h = bme280_osrs_factor(c->osrs_h);
+	unsigned coef = bme280_filter_coef((c->regs[BME280_REG_CONFIG] >> 2) & 0x07);
+	double sec = (double)(t - sim->t0) / 1e9;
+	uint8_t *r = c->regs;
+
+	double tv = os_t ? sim_wave(c, &sim->spec.t, sec, os_t) : 0;
+	double pv = os_p ? sim_wave(c, &sim->spec.p, sec, os_p) : 0;
+	double hv = os_h ? sim_wave(c, &sim->spec.h, sec, os_h) : 0;
+	if (coef == 0 || !c->filtered) {
+		c->ft = tv;
+		c->fp = pv;
+		c->filtered = 1;
+	} else {
+		c->ft = (c->ft * (coef - 1) + tv) / coef;
+		c->fp = (c->fp * (coef - 1) + pv) / coef;
+	}
+
+	/* Temperature first: its t_fine is what P and H are compensated with */
+	int32_t adc_t = SIM_SKIPPED_20;
+	if (os_t) {
+		adc_t = sim_invert(c, 20, 1, c->ft * 100, comp_t);
+		adc_t = sim_quantize(adc_t, os_t, coef != 0);
+		(void)bme280_comp_T(adc_t, &c->calib);
+	}
+	put20(r + BME280_REG_TEMP_MSB, adc_t);
+	put20(r + BME280_REG_PRESS_MSB, os_p ?
+	      sim_quantize(sim_invert(c, 20, 0, c->fp * 100 * 256, comp_p), os_p, coef != 0) : SIM_SKIPPED_20);
+	if (hv < 0) hv = 0;
+	if (hv > 100) hv = 100;
+	int32_t adc_h = os_h ? sim_invert(c, 16, 1, hv * 1024, comp_h) : SIM_SKIPPED_16;
+	r[BME280_REG_HUM_MSB] = (uint8_t)(adc_h >> 8);
+	r[BME280_REG_HUM_MSB + 1] = (uint8_t)adc_h;
+}
+
+/* Datasheet typical measurement time (appendix B), ns */
+static int64_t sim_meas_ns(const sim_chip_t *c)
+{
+	uint8_t meas = c->regs[BME280_REG_CTRL_MEAS];
+	unsigned os_t = bme280_osrs_factor(meas >> 5);
+	unsigned os_p = bme280_osrs_factor((meas >> 2) & 0x07);
+	unsigned os_h = bme280_osrs_factor(c->osrs_h);
+	int64_t us = 1000 + 2000 * os_t;
+	if (os_p) us += 2000 * os_p + 500;
+	if (os_h) us += 2000 * os_h + 500;
+	return us * 1000;
+}
+
+/* Bring c up to time now; returns the measuring bit */
+static int sim_advance(sim_t *sim, sim_chip_t *c, int64_t now)
+{
+	uint8_t *meas = &c->regs[BME280_REG_CTRL_MEAS];
+	int mode = *meas & 0x03;
+
+	if (mode == BME280_MODE_SLEEP) return 0;
+	if (mode != BME280_MODE_NORMAL) {
+		if (now < c->done) return 1;
+		sim_convert(sim, c, c->done);
+		*meas &= (uint8_t)~0x03;                    /* back to sleep */
+		return 0;
+	}
+
+	int64_t meas_ns = sim_meas_ns(c);
+	int64_t cycle = meas_ns + (int64_t)bme280_standby_us(c->regs[BME280_REG_CONFIG] >> 5) * 1000;
+	uint64_t finished = (uint64_t)((now - c->start + cycle - meas_ns) / cycle);
+	if (finished > c->cycles + SIM_CATCHUP) c->cycles = finished - SIM_CATCHUP;
+	for (; c->cycles < finished; c->cycles++) {
+		sim_convert(sim, c, c->start + (int64_t)c->cycles * cycle + meas_ns);
+	}
+	return (now - c->start) % cycle < meas_ns;
+}
+
+/* ---------------- Register map ---------------- */
+static void sim_reset(sim_chip_t *c, int64_t now)
+{
+	uint8_t nvm[BME280_CALIB_LEN];
+
+	memset(c->regs, 0, sizeof c->regs);
+	c->regs[BME280_REG_ID] = BME280_CHIP_ID;
+	bme280_pack_calib(&c->calib, nvm);
+	memcpy(c->regs + BME280_CALIB00, nvm, BME280_CALIB00_LEN);
+	memcpy(c->regs + BME280_CALIB26, nvm + BME280_CALIB00_LEN, BME280_CALIB26_LEN);
+	put20(c->regs + BME280_REG_PRESS_MSB, SIM_SKIPPED_20);
+	put20(c->regs + BME280_REG_TEMP_MSB, SIM_SKIPPED_20);
+	c->regs[BME280_REG_HUM_MSB] = SIM_SKIPPED_16 >> 8;
+	c->osrs_h = 0;
+	c->filtered = 0;
+	c->reset_end = now + SIM_RESET_NS;
+}
+
+static sim_chip_t *sim_chip(sim_t *sim, uint16_t addr)
+{
+	for (int i = 0; i < sim->nchip; i++) {
+		if (sim->chip[i].addr == addr) return &sim->chip[i];
+	}
+	if (sim->nchip == SIM_CHIPS) return NULL;
+	sim_chip_t *c = &sim->chip[sim->nchip++];
+	c->addr = addr;
+	c->calib = sim_calib;
+	c->rng = 0x9E3779B97F4A7C15ull ^ addr;
+	sim_reset(c, sim->t0);
+	return c;
+}
+
+static int sim_read_regs(void *ctx, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len)
+{
+	sim_t *sim = ctx;
+	sim_chip_t *c = sim_chip(sim, addr);
+	if (!c) {
+		errno = ENXIO;                      /* nobody answers */
+		return -1;
+	}
+
+	int64_t now = now_ns();
+	int measuring = sim_advance(sim, c, now);
+	c->regs[BME280_REG_STATUS] = (uint8_t)((measuring ? BME280_STATUS_MEASURING : 0) |
+	                                       (now < c->reset_end ? BME280_STATUS_IM_UPDATE : 0));
+	for (size_t i = 0; i < len; i++) buf[i] = c->regs[(uint8_t)(start_reg + i)];
+	return 0;
+}
+
+static int sim_write_reg(void *ctx, uint16_t addr, uint8_t reg, uint8_t val)
+{
+	sim_t *sim = ctx;
+	sim_chip_t *c = sim_chip(sim, addr);
+	if (!c) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	int64_t now = now_ns();
+	(void)sim_advance(sim, c, now);
+	switch (reg) {
+	case BME280_REG_RESET:
+		if (val == 0xB6) sim_reset(c, now);
+		break;
+	case BME280_REG_CTRL_HUM:
+		c->regs[reg] = val & 0x07;
+		break;
+	case BME280_REG_CONFIG:
+		c->regs[reg] = val & 0xFD;
+		break;
+	case BME280_REG_CTRL_MEAS:
+		c->regs[reg] = val;
+		c->osrs_h = c->regs[BME280_REG_CTRL_HUM];
+		c->start = now;
+		c->cycles = 0;
+		c->done = now + sim_meas_ns(c);
+		break;
+	default:
+		break;                              /* read-only */
+	}
+	return 0;
+}
+
+static void sim_close(void *ctx)
+{
+	free(ctx);
+}
+
+static const bme280_transport_t sim_transport = { sim_read_regs, sim_write_reg, sim_close };
+
+int bme280sim_open(const char *dev)
+{
+	sim_t *sim = calloc(1, sizeof *sim);
+	if (!sim) return -1;
+	if (bme280sim_parse(dev, &sim->spec) < 0) {
+		free(sim);
+		errno = EINVAL;
+		return -1;
+	}
+	sim->t0 = now_ns() - SIM_RESET_NS;          /* powered up a while ago */
+
+	/* A real descriptor, so the caller's fd bookkeeping is unchanged */
+	int fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+	if (fd < 0 || bme280_transport_attach(fd, &sim_transport, sim) < 0) {
+		if (fd >= 0) close(fd);
+		free(sim);
+		errno = EMFILE;
+		return -1;
+	}
+	return fd;
+}
@@ -0,0 +1,42 @@
+/*
+ * bme280sim.h: In-process BME280 simulator, a register-map backend for
+ * the libbme280 transport.
+ *
+ * Stands in for an I2C bus (any number of slave addresses) or an SPI chip
+ * select, so the whole sampling path runs without hardware: chip id 0x60,
+ * a real calibration image, soft reset with the NVM copy (im_update),
+ * forced and normal mode with datasheet typical conversion and standby
+ * times (measuring bit included), ctrl_hum latched by the ctrl_meas write,
+ * oversampling-dependent noise and resolution, the IIR filter, and skipped
+ * channels reading 0x80000/0x8000. ADC codes are the exact inverse of the
+ * library's compensation, so a reading comes back as the configured value
+ * to within the compensation's own rounding.
+ *
+ * Device string: "sim" or "sim:t=<w>:p=<w>:h=<w>", a waveform per channel
+ * <w> = <base>[/<amplitude>[/<period s>[/<noise sd>]]] in °C, hPa and %RH;
+ * e.g. "sim:t=21/2/60/0.05:h=40". Noise is deterministic (fixed seed).
+ */
+#ifndef BME280SIM_H
+#define BME280SIM_H
+
+#include "libbme280.h"
+
+#define BME280SIM_PREFIX "sim"
+
+typedef struct {
+	double base, amp, period, noise;
+} bme280sim_wave_t;
+
+typedef struct {
+	bme280sim_wave_t t, p, h;    /* °C, hPa, %RH */
+} bme280sim_spec_t;
+
+/* dev names the simulator ("sim" or "sim:...") */
+int bme280sim_is_sim(const char *dev);
+/* Parse a device string; 0 or -1 */
+int bme280sim_parse(const char *dev, bme280sim_spec_t *spec);
+/* A descriptor served by a new simulator (release with bme280_close());
+ * -1 with errno EINVAL on a bad device string */
+int bme280sim_open(const char *dev);
+
+#endif /* BME280SIM_H */
@@ -1,5 +1,6 @@
 /*
- * bpbme280.c: Read BME280 + CPU stats once, send a single JSON bundle via ION BP.
+ * bpbme280.c: Read BME280 + CPU stats, send a JSON bundle via ION BP (one-shot,
+ *             or periodically with -i).
  *
  * JSON payload (compact with short headers + short keys):
  * {
@@ -13,35 +14,107 @@
  * }
  *
  * Usage:
- *   bpbme280 <sourceEID> <destEID> [-t<ttl>] [-a0x76|0x77] [-d/dev/i2c-X] [-loc<location>]
+ *   bpbme280 <sourceEID> <destEID> [-t<ttl>] [-a0x76|0x77] [-d/dev/i2c-X] [-s/dev/spidevX.Y] [-loc<location>] [-i<seconds>] [-mforced|normal]
+ *            [-cache<dir>|-nocache] [-spill<file>|-nospill] [-journal<file>|-nojournal]
+ *            [-sensor<dev>@<addr> ...]
+ *            [-n<samples>] [-w<seconds>] [-z<bytes>] [-fjson|cbor|raw] [-r<hz>] [-summary<seconds>]
+ *            [-deadband<t>,<p>,<h>[,<ct>,<l>] [-heartbeat<seconds>] [-state<file>|-nostate]]
+ *            [-preset<weather|humidity|indoor|gaming>] [-osrs<t>,<p>,<h>] [-filter<coef>] [-standby<ms>]
+ *            [-metrics<file>]
  *     -t : Bundle TTL seconds (default 300)
  *     -a : I2C address (default 0x76)
- *     -d : I2C device path (default /dev/i2c-1)
+ *     -d : I2C device path (default /dev/i2c-1), or "sim[:t=..:p=..:h=..]" for the simulator (bme280sim.h)
+ *     -s : Use 4-wire SPI on this spidev node instead of I2C (10 MHz, mode 0)
+ *     -sensor : Add a sensor, e.g. -sensor/dev/i2c-1@0x77 or
+ *          -sensor/dev/spidev0.1@spi (repeatable; replaces -d/-a/-s). Sensors get ids 1..n in order; each bus is read by its
+ *          own thread and every tick's records go out in one bundle,
+ *          tagged with "sid"
  *     -loc : Location string (optional)
+ *     -i : Sampling interval in seconds; stay attached and send one bundle
+ *          per interval until SIGINT/SIGTERM (default 0 = one-shot)
+ *     -cache : Calibration cache directory (default /var/cache/bpbme280)
+ *     -nocache : Always read calibration from the sensor
+ *     -spill : Spill file for payloads ION has no ZCO/SDR space for,
+ *              replayed in order later, each to the destination it was
+ *              queued for (default /var/cache/bpbme280/spill); a file
+ *              another bpbme280 holds is not shared, sends block instead
+ *     -nospill : Block on the attendant until ION has space instead
+ *     -journal : Journal for samples taken while bp_attach() fails, sent
+ *                as batches once BP is up (default /var/cache/bpbme280/journal)
+ *     -nojournal : Exit if BP is unavailable
+ *     -summary : Instead of every sample, send one summary per sensor and
+ *                window of this many seconds (min/max/mean/sd per field)
+ *     -deadband : Send a reading only if a field moved by more than its
+ *                 threshold (°C, hPa, %RH, °C, load; empty = not watched)
+ *                 since the last one sent, or the heartbeat expired
+ *     -heartbeat : Send at least every this many seconds (default 3600,
+ *                  0 = only on change)
+ *     -state : Last-sent readings for -deadband, kept across runs to the
+ *              same destination (default /var/cache/bpbme280/lastsent);
+ *              -nostate: memory only
+ *     -f : Payload format: json (default), cbor, or raw (uncompensated
+ *          ADC bytes + calibration, compensated on the receiver); see
+ *          record.h, decode with bpbme280dec
+ *     -m : Measurement mode: forced (default; one conversion per sample,
+ *          sensor sleeps in between) or normal (free-running, 500 ms standby)
+ *     -preset : Bosch recommended settings (datasheet 3.5); -m, -osrs,
+ *               -filter and -standby override single values
+ *     -osrs : Oversampling of T, P, H: 0 (skip; not T), 1, 2, 4, 8 or 16
+ *             (default 1,1,1)
+ *     -filter : IIR filter coefficient 0 (off, default), 2, 4, 8 or 16
+ *     -standby : Normal-mode standby in ms: 0.5, 10, 20, 62.5, 125, 250,
+ *                500 (default) or 1000
+ *   The resulting measurement time and maximum output data rate are
+ *   printed at startup.
+ *     -metrics : Prometheus textfile-collector file: bus transactions and
+ *                errors, read retries, bundles and bytes sent, send
+ *                failures, latency histograms of the conversion wait, SDR
+ *                transaction, ZCO creation and bp_send() (metrics.h);
+ *                rewritten every 10 s and at exit
+ *     -r : High-rate streaming at this many samples/s (1..200, one sensor):
+ *          normal mode with 0.5 ms standby, status-driven reads, ms
+ *          timestamps, one bundle per -n samples (default: one second's worth)
+ *
+ *   With -i or -r a sampling thread feeds the BP thread through a lock-free
+ *   ring (ring.h), so bundle backpressure never delays a sample.
  *
  * Build:
  *   gcc -O2 -Wall -Wextra -std=c11 bpbme280.c -o bpbme280 -lbp -lici -lpthread
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
-#include <fcntl.h>
-#include <linux/i2c-dev.h>
+#include <limits.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ioctl.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include <math.h>
 #include <bp.h>                   /* ION BP API */
 
+#include "bptx.h"
+#include "calcache.h"
+#include "cbor.h"
+#include "cpustat.h"
+#include "deadband.h"
+#include "libbme280.h"
+#include "metrics.h"
+#include "record.h"
+#include "ring.h"
+#include "sensors.h"
+#include "spill.h"
+#include "welford.h"
+
 /* ---------------- Run-control (like bpsource) ---------------- */
 static int _running(int *newState)
 {
-	int state = 1;                 /* default: running */
+	static int state = 1;          /* default: running */
 	if (newState) { state = *newState; }
 	return state;
 }
@@ -58,203 +131,712 @@ static void handleQuit(int signum)
 	(void)signum;
 	int stop = 0;
 	oK(_running(&stop));
-	ionPauseAttendant(_attendant(NULL));
-}
-
-/* ---------------- BME280 registers/calibration ---------------- */
-#define BME280_CHIP_ID 0x60
-#define REG_ID         0xD0
-#define REG_RESET      0xE0
-#define REG_CTRL_HUM   0xF2
-#define REG_STATUS     0xF3
-#define REG_CTRL_MEAS  0xF4
-#define REG_CONFIG     0xF5
-#define REG_PRESS_MSB  0xF7
-#define REG_TEMP_MSB   0xFA
-#define REG_HUM_MSB    0xFD
-#define CALIB00        0x88  /* 0x88..0xA1 (26 bytes) */
-#define CALIB26        0xE1  /* 0xE1..0xE7 (7 bytes)  */
+	if (_attendant(NULL)) { ionPauseAttendant(_attendant(NULL)); }
+}
+
+/* ------------- Per-tick fields shared by all sensors -------------- */
+static void read_stats(const cpustat_t *cs, sample_t *s)
+{
+	memset(s, 0, sizeof *s);
+	(void)cpustat_temp_mC(cs, &s->cpu_temp);  /* ignore failures (leave 0) */
+	(void)cpustat_load_1min(cs, &s->load);
+	s->ts = (int64_t)time(NULL);
+}
+
+/* ------------- Batch of records -> one bundle -------------- */
+/* Records are collected as a JSON array [{...},{...},...] or, for CBOR,
+ * an indefinite-length array 0x9f {..} {..} ... 0xff. Raw batches start
+ * with a calibration-only map per sensor so each bundle decodes on its own.
+ * With several sensors every tick's records go out together this way. */
+#define FMT_JSON 0
+#define FMT_CBOR 1
+#define FMT_RAW  2
+
+#define BATCH_BUF_MAX        16384
+#define BATCH_DEFAULT_BYTES  4096
+/* Rough per-bundle cost on the wire (BPv7 primary + payload block headers) */
+#define BUNDLE_OVERHEAD_EST  48
 
 typedef struct {
-	/* Temperature */
-	uint16_t dig_T1; int16_t dig_T2; int16_t dig_T3;
-	/* Pressure */
-	uint16_t dig_P1; int16_t dig_P2; int16_t dig_P3; int16_t dig_P4; int16_t dig_P5;
-	int16_t dig_P6; int16_t dig_P7; int16_t dig_P8; int16_t dig_P9;
-	/* Humidity */
-	uint8_t  dig_H1; int16_t dig_H2; uint8_t dig_H3; int16_t dig_H4; int16_t dig_H5; int8_t dig_H6;
-	/* Shared */
-	int32_t t_fine;
-} bme280_calib_t;
+	int    fmt;                 /* FMT_JSON, FMT_CBOR or FMT_RAW */
+	const sensors_t *sensors;   /* FMT_RAW: NVM images for the batch head */
+	int    tagged;              /* records carry sensor ids */
+	char   buf[BATCH_BUF_MAX];
+	int    len;                 /* bytes used, excluding the closing byte */
+	int    count;               /* records in buf */
+	int    rec_bytes;           /* sum of record lengths (for reporting) */
+	struct timespec first;      /* monotonic time of the first record */
+} batch_t;
 
-/* --------- Minimal I2C helpers (no WiringPi needed) ---------- */
-static int i2c_write_reg(int fd, uint8_t reg, uint8_t val)
+static void batch_reset(batch_t *b)
 {
-	uint8_t buf[2] = {reg, val};
-	return (write(fd, buf, 2) == 2) ? 0 : -1;
+	b->buf[0] = (b->fmt == FMT_JSON) ? '[' : (char)CBOR_INDEF_ARRAY;
+	b->len = 1;
+	for (int i = 0; b->fmt == FMT_RAW && i < b->sensors->n; i++) {
+		const sensor_t *sn = &b->sensors->sensor[i];
+		b->len += compose_calib(b->buf + b->len, sizeof(b->buf) - b->len, sn->calib_raw,
+		                        b->tagged ? sn->sid : 0);
+	}
+	b->count = 0;
+	b->rec_bytes = 0;
 }
 
-static int i2c_read_reg(int fd, uint8_t reg, uint8_t *val)
+/* Append one record; caller flushes first if it would not fit. */
+static int batch_add(batch_t *b, const char *rec, int len, int max_bytes)
 {
-	if (write(fd, &reg, 1) != 1) return -1;
-	return (read(fd, val, 1) == 1) ? 0 : -1;
+	int sep = (b->fmt == FMT_JSON && b->count) ? 1 : 0;
+	if (b->len + sep + len + 1 > max_bytes) return -1;  /* + closing byte */
+	if (b->count == 0) clock_gettime(CLOCK_MONOTONIC, &b->first);
+	if (sep) b->buf[b->len++] = ',';
+	memcpy(b->buf + b->len, rec, len);
+	b->len += len;
+	b->rec_bytes += len;
+	b->count++;
+	return 0;
 }
 
-static int i2c_read_regs(int fd, uint8_t start_reg, uint8_t *buf, size_t len)
+static int batch_age_sec(const batch_t *b)
 {
-	if (write(fd, &start_reg, 1) != 1) return -1;
-	return (read(fd, buf, len) == (ssize_t)len) ? 0 : -1;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int)(now.tv_sec - b->first.tv_sec);
 }
 
-/* ---------------- BME280 setup & compensation ---------------- */
-static int bme280_read_calib(int fd, bme280_calib_t *c)
+/* A batch BP fails on stays as it is, to be sent by the next flush */
+static int batch_flush(batch_t *b, bptx_t *tx)
 {
-	uint8_t b1[26], b2[7];
-	if (i2c_read_regs(fd, CALIB00, b1, sizeof(b1)) < 0) return -1;
-	if (i2c_read_regs(fd, CALIB26, b2, sizeof(b2)) < 0) return -1;
+	if (b->count == 0) return 0;
+	b->buf[b->len] = (b->fmt == FMT_JSON) ? ']' : (char)CBOR_BREAK;
+	int len = b->len + 1;
+	if (bptx_deliver(tx, b->buf, len) < 0) return -1;
+	printf("[i] batch: %d samples, %d bytes payload, ~%.1f bytes/sample on wire (~%.1f unbatched)\n",
+	       b->count, len,
+	       (double)(len + BUNDLE_OVERHEAD_EST) / b->count,
+	       (double)b->rec_bytes / b->count + BUNDLE_OVERHEAD_EST);
+	fflush(stdout);
+	batch_reset(b);
+	return 0;
+}
 
-#define U16_LE(p) ((uint16_t)((p)[0] | ((uint16_t)(p)[1] << 8)))
-#define S16_LE(p) ((int16_t)((p)[0] | ((int16_t)(p)[1] << 8)))
+/* ---------- Timespec arithmetic ---------- */
+static void timespec_add_ns(struct timespec *t, long ns)
+{
+	t->tv_nsec += ns;
+	while (t->tv_nsec >= 1000000000L) {
+		t->tv_nsec -= 1000000000L;
+		t->tv_sec++;
+	}
+}
 
-	c->dig_T1 = U16_LE(&b1[0]);  c->dig_T2 = S16_LE(&b1[2]);  c->dig_T3 = S16_LE(&b1[4]);
-	c->dig_P1 = U16_LE(&b1[6]);  c->dig_P2 = S16_LE(&b1[8]);  c->dig_P3 = S16_LE(&b1[10]);
-	c->dig_P4 = S16_LE(&b1[12]); c->dig_P5 = S16_LE(&b1[14]); c->dig_P6 = S16_LE(&b1[16]);
-	c->dig_P7 = S16_LE(&b1[18]); c->dig_P8 = S16_LE(&b1[20]); c->dig_P9 = S16_LE(&b1[22]);
-	c->dig_H1 = b1[24];
+static double timespec_diff_ms(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1e3 + (a->tv_nsec - b->tv_nsec) / 1e6;
+}
 
-	c->dig_H2 = S16_LE(&b2[0]);
-	c->dig_H3 = b2[2];
-	c->dig_H4 = (int16_t)((((int16_t)b2[3]) << 4) | (b2[4] & 0x0F));
-	c->dig_H5 = (int16_t)((((int16_t)b2[5]) << 4) | (b2[4] >> 4));
-	c->dig_H6 = (int8_t)b2[6];
-	return 0;
+/* ------------- One record in the selected format -------------- */
+static int compose_record(int fmt, char *buf, size_t buflen, const sample_t *s,
+                          const uint8_t *raw, const uint8_t *calib, const char *location)
+{
+	if (fmt == FMT_RAW)  return compose_raw(buf, buflen, s, raw, calib, location);
+	if (fmt == FMT_CBOR) return compose_cbor(buf, buflen, s, location);
+	return compose_json(buf, buflen, s, location);
 }
 
-static int bme280_configure(int fd)
+/* ------------- Sampling thread -> ring -> bundler -------------- */
+/* In the continuous modes (-i, -r) a dedicated thread samples on a fixed
+ * schedule and pushes records into a lock-free SPSC ring; the main thread,
+ * the only one that talks to BP, drains the ring into bundles. bp_send()
+ * and ionCreateZco() may block on the attendant while ZCO space is
+ * exhausted: that only fills the ring and never delays a sample. A
+ * one-shot run does its single tick on the main thread.
+ *
+ * -r: normal mode with 0.5 ms standby, so the sensor converts back to back
+ * and every tick reads the newest result right after the measuring bit
+ * drops. Samples are timestamped (CLOCK_REALTIME, ms) the moment the read
+ * returns. */
+#define STREAM_MAX_HZ      200
+#define STREAM_REPORT_SEC  10
+#define RING_CAP           8192      /* records; ~40 s at the top rate */
+
+typedef struct {
+	uint64_t n;                  /* samples */
+	uint64_t missed;             /* ticks skipped after falling behind */
+	double   sum, sumsq;         /* inter-sample intervals, ms */
+	double   min, max;
+	struct timespec last;        /* monotonic time of the last sample */
+} stream_stats_t;
+
+static void stream_stats_add(stream_stats_t *st, const struct timespec *t)
 {
-	/* Humidity oversampling x1 */
-	if (i2c_write_reg(fd, REG_CTRL_HUM, 0x01) < 0) return -1;
-	/* Temp os x1, Press os x1, mode normal */
-	if (i2c_write_reg(fd, REG_CTRL_MEAS, 0x27) < 0) return -1;
-	/* Standby 500ms, filter off */
-	if (i2c_write_reg(fd, REG_CONFIG, 0x80) < 0) return -1;
-	return 0;
+	if (st->n > 0) {
+		double dt = timespec_diff_ms(t, &st->last);
+		if (st->n == 1 || dt < st->min) st->min = dt;
+		if (st->n == 1 || dt > st->max) st->max = dt;
+		st->sum += dt;
+		st->sumsq += dt * dt;
+	}
+	st->last = *t;
+	st->n++;
 }
 
-static int bme280_read_raw(int fd, int32_t *adc_T, int32_t *adc_P, int32_t *adc_H)
+typedef struct {
+	sensors_t       *sensors;
+	const cpustat_t *cs;
+	int              interval;       /* -i: seconds per tick, or */
+	int              hz;             /* -r: ticks per second */
+	int              tagged;         /* records carry sensor ids */
+	ring_t           ring;
+	sample_t         base;           /* per-tick fields (-r: refreshed each second) */
+	time_t           base_sec;
+	stream_stats_t   st;             /* -r; written by the sampling thread only */
+	sem_t            avail;          /* posted after each tick that queued records */
+	pthread_mutex_t  lock;           /* quit and the wait for the next tick */
+	pthread_cond_t   wake;
+	int              quit;
+	pthread_t        thread;
+	int              started;
+} sampler_t;
+
+/* Ring occupancy and drops; counters are read without stopping the producer */
+static void ring_report(const ring_t *r)
 {
-	uint8_t d[8];
-	if (i2c_read_regs(fd, REG_PRESS_MSB, d, sizeof d) < 0) return -1;
-	*adc_P = ((int32_t)d[0] << 12) | ((int32_t)d[1] << 4) | (d[2] >> 4);
-	*adc_T = ((int32_t)d[3] << 12) | ((int32_t)d[4] << 4) | (d[5] >> 4);
-	*adc_H = ((int32_t)d[6] << 8) | d[7];
-	return 0;
+	printf("[i] ring: %zu of %zu queued, peak %zu, %llu dropped\n",
+	       ring_count(r), ring_capacity(r), ring_peak(r), (unsigned long long)ring_dropped(r));
+	fflush(stdout);
+}
+
+/* Achieved rate and inter-sample jitter since the start of the stream */
+static void stream_report(const sampler_t *sp)
+{
+	const stream_stats_t *st = &sp->st;
+	if (st->n < 2) return;
+	double k = (double)(st->n - 1);
+	double mean = st->sum / k;
+	double var = st->sumsq / k - mean * mean;
+	printf("[i] stream: %.1f Hz (target %d), interval mean %.3f ms, jitter sd %.3f ms "
+	       "(min %.3f, max %.3f); %llu samples, %llu missed ticks\n",
+	       1000.0 / mean, sp->hz, mean, var > 0 ? sqrt(var) : 0.0, st->min, st->max,
+	       (unsigned long long)st->n, (unsigned long long)st->missed);
+	ring_report(&sp->ring);
+}
+
+/* One tick: read the sensor(s) and queue a record per good reading.
+ * Returns records queued. */
+static int sampler_tick(sampler_t *sp)
+{
+	sensors_t *ss = sp->sensors;
+	ring_item_t it;
+	int queued = 0, last = -1;
+
+	if (sp->hz) {
+		const sensor_t *sn = &ss->sensor[0];
+		struct timespec mono, real;
+
+		/* CPU stats once a second */
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+		if (mono.tv_sec != sp->base_sec) {
+			read_stats(sp->cs, &sp->base);
+			sp->base_sec = mono.tv_sec;
+		}
+		if (sensors_read_ready(ss, 0) < 0) return 0;
+		clock_gettime(CLOCK_REALTIME, &real);
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+		stream_stats_add(&sp->st, &mono);
+		it.s = sp->base;
+		it.s.ts = (int64_t)real.tv_sec;
+		it.s.ts_ms = (int64_t)real.tv_sec * 1000 + real.tv_nsec / 1000000;
+		it.s.temp = sn->data.temp;
+		it.s.press = sn->data.press;
+		it.s.humid = sn->data.humid;
+		memcpy(it.raw, sn->raw, BME280_RAW_LEN);
+		it.tick_end = 1;
+		return ring_push(&sp->ring, &it) == 0;
+	}
+
+	/* Forced mode: one conversion per tick, sensors sleep in between */
+	if (sensors_sample(ss) == 0) {
+		putErrmsg("Failed to read BME280.", NULL);
+	}
+	read_stats(sp->cs, &sp->base);
+	for (int k = 0; k < ss->n; k++) {
+		if (ss->sensor[k].ok) last = k;
+	}
+	for (int k = 0; k < ss->n; k++) {
+		const sensor_t *sn = &ss->sensor[k];
+		if (!sn->ok) {
+			if (sp->tagged) putErrmsg("Failed to read BME280.", sn->dev);
+			continue;
+		}
+		it.s = sp->base;
+		it.s.sid   = sp->tagged ? sn->sid : 0;
+		it.s.temp  = sn->data.temp;
+		it.s.press = sn->data.press;
+		it.s.humid = sn->data.humid;
+		memcpy(it.raw, sn->raw, BME280_RAW_LEN);
+		it.tick_end = (k == last);
+		if (ring_push(&sp->ring, &it) == 0) queued++;
+	}
+	return queued;
+}
+
+static void *sampler_main(void *arg)
+{
+	sampler_t *sp = arg;
+	long period_ns = sp->hz ? 1000000000L / sp->hz : 0;
+	struct timespec next, now, last_report;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	last_report = next;
+	pthread_mutex_lock(&sp->lock);
+	while (!sp->quit) {
+		pthread_mutex_unlock(&sp->lock);
+
+		if (sampler_tick(sp) > 0) sem_post(&sp->avail);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (sp->hz && now.tv_sec - last_report.tv_sec >= STREAM_REPORT_SEC) {
+			stream_report(sp);
+			last_report = now;
+		}
+
+		/* Fixed-rate schedule: drift-free, skip (and count) missed ticks */
+		if (sp->hz) {
+			timespec_add_ns(&next, period_ns);
+			while (timespec_diff_ms(&now, &next) > 0) {
+				timespec_add_ns(&next, period_ns);
+				sp->st.missed++;
+			}
+		} else {
+			do {
+				next.tv_sec += sp->interval;
+			} while (next.tv_sec < now.tv_sec);
+		}
+
+		pthread_mutex_lock(&sp->lock);
+		while (!sp->quit && pthread_cond_timedwait(&sp->wake, &sp->lock, &next) != ETIMEDOUT)
+			;
+	}
+	pthread_mutex_unlock(&sp->lock);
+	return NULL;
 }
 
-/* Compensation as per datasheet (integer math; returns doubles) */
-static double bme280_comp_T(int32_t adc_T, bme280_calib_t *c)
+static int sampler_start(sampler_t *sp)
 {
-	int32_t var1 = ((((adc_T >> 3) - ((int32_t)c->dig_T1 << 1))) * ((int32_t)c->dig_T2)) >> 11;
-	int32_t var2 = (((((adc_T >> 4) - ((int32_t)c->dig_T1)) * ((adc_T >> 4) - ((int32_t)c->dig_T1))) >> 12) *
-	               ((int32_t)c->dig_T3)) >> 14;
-	c->t_fine = var1 + var2;
-	double T = (c->t_fine * 5 + 128) >> 8; /* °C * 100 */
-	return T / 100.0;
+	pthread_condattr_t ca;
+	sigset_t block, old;
+
+	sem_init(&sp->avail, 0, 0);
+	pthread_mutex_init(&sp->lock, NULL);
+	pthread_condattr_init(&ca);
+	pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+	pthread_cond_init(&sp->wake, &ca);
+	pthread_condattr_destroy(&ca);
+	sp->quit = 0;
+	sp->base_sec = -1;
+
+	/* SIGINT/SIGTERM stay with the main thread, which stops the sampler */
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &block, &old);
+	int rc = pthread_create(&sp->thread, NULL, sampler_main, sp);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	sp->started = (rc == 0);
+	return (rc == 0) ? 0 : -1;
 }
 
-static double bme280_comp_P(int32_t adc_P, bme280_calib_t *c)
+static void sampler_stop(sampler_t *sp)
 {
-	int64_t var1 = ((int64_t)c->t_fine) - 128000;
-	int64_t var2 = var1 * var1 * (int64_t)c->dig_P6;
-	var2 = var2 + ((var1 * (int64_t)c->dig_P5) << 17);
-	var2 = var2 + (((int64_t)c->dig_P4) << 35);
-	var1 = ((var1 * var1 * (int64_t)c->dig_P3) >> 8) + ((var1 * (int64_t)c->dig_P2) << 12);
-	var1 = (((((int64_t)1) << 47) + var1) * ((int64_t)c->dig_P1)) >> 33;
-	if (var1 == 0) return 0.0;
+	if (!sp->started) return;
+	sp->started = 0;
+	pthread_mutex_lock(&sp->lock);
+	sp->quit = 1;
+	pthread_cond_signal(&sp->wake);
+	pthread_mutex_unlock(&sp->lock);
+	pthread_join(sp->thread, NULL);
+	sem_destroy(&sp->avail);
+}
 
-	int64_t p = 1048576 - adc_P;
-	p = (((p << 31) - var2) * 3125) / var1;
-	var1 = (((int64_t)c->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-	var2 = (((int64_t)c->dig_P8) * p) >> 19;
-	p = ((p + var1 + var2) >> 8) + (((int64_t)c->dig_P7) << 4);
-	return ((double)p) / 25600.0; /* hPa */
+/* ------------- Windowed summaries (-summary) -------------- */
+/* Instead of every sample, one record per sensor and window with min, max,
+ * mean and standard deviation of each field, kept with Welford's update
+ * (O(1) memory per field). Windows are aligned to multiples of their length
+ * in UNIX time and closed by the first sample of the next window, once the
+ * clock passes their end, or at shutdown (a partial window). */
+typedef struct {
+	int       span;                  /* seconds */
+	int64_t   start;                 /* open window; 0 = none */
+	welford_t f[SENSORS_MAX + 1][REC_KEY_LOC];   /* by sid, then REC_KEY_TEMP..REC_KEY_LOAD */
+} summary_acc_t;
+
+static void summary_add(summary_acc_t *acc, const sample_t *s)
+{
+	double x[REC_KEY_LOC];
+	rec_to_summary_units(s, x);
+	if (acc->start == 0) acc->start = s->ts - s->ts % acc->span;
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) welford_add(&acc->f[s->sid][k], x[k]);
 }
 
-static double bme280_comp_H(int32_t adc_H, bme280_calib_t *c)
+/* Close the window of one sensor; 0, or -1 if it saw no samples */
+static int summary_take(summary_acc_t *acc, int32_t sid, summary_t *sum)
 {
-	int32_t x = c->t_fine - 76800;
-	int32_t v = (((((adc_H << 14) - (((int32_t)c->dig_H4) << 20) - ((int32_t)c->dig_H5 * x)) + 16384) >> 15) *
-	            (((((((x * (int32_t)c->dig_H6) >> 10) * (((x * (int32_t)c->dig_H3) >> 11) + 32768)) >> 10) + 2097152) *
-	               ((int32_t)c->dig_H2 + 8192)) >> 14));
-	v = v - (((((v >> 15) * (v >> 15)) >> 7) * (int32_t)c->dig_H1) >> 4);
-	if (v < 0) v = 0;
-	if (v > 419430400) v = 419430400;
-	double h = (v >> 12) / 1024.0;
-	return h; /* %RH */
+	welford_t *f = acc->f[sid];
+	if (f[REC_KEY_TEMP].n == 0) return -1;
+	memset(sum, 0, sizeof *sum);
+	sum->ts = acc->start;
+	sum->span = acc->span;
+	sum->n = (uint32_t)f[REC_KEY_TEMP].n;
+	sum->sid = sid;
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) {
+		sum->v[k][REC_SUM_MIN]  = llround(f[k].min);
+		sum->v[k][REC_SUM_MAX]  = llround(f[k].max);
+		sum->v[k][REC_SUM_MEAN] = llround(f[k].mean);
+		sum->v[k][REC_SUM_SD]   = llround(welford_sd(&f[k]));
+		welford_init(&f[k]);
+	}
+	return 0;
 }
 
-/* ---------------- CPU stats (Pi) ---------------- */
-static int read_cpu_temp_c(double *outC)
+typedef struct {
+	int            fmt;
+	const char    *location;
+	int            echo;          /* print every record */
+	int            combine;       /* records go through the batch */
+	int            per_bundle;    /* flush at a tick end once this many are batched */
+	int            max_age;       /* seconds; 0 = no age limit */
+	int            max_bytes;
+	batch_t       *batch;
+	bptx_t        *tx;
+	int            calib_sent;    /* unbatched raw: calibration delivered */
+	int            sent;          /* bundles */
+	summary_acc_t *sum;           /* -summary: samples only feed the statistics */
+	deadband_t    *db;            /* -deadband: unchanged readings are skipped */
+	spill_t       *jn;            /* journal replay: the journal, consumed as bundles go out */
+	size_t         jn_done;       /* entries in front of this are in the batch or done with */
+	int            replay;        /* records come from the journal, not the sampler */
+} bundler_t;
+
+/* Send the batch; journal entries it carried leave the journal, and its
+ * readings become the dead band's last-sent ones, only now */
+static int bundler_flush(bundler_t *bd)
 {
-	const char *path = "/sys/class/thermal/thermal_zone0/temp";
-	FILE *f = fopen(path, "r");
-	if (!f) return -1;
-	long mC = 0;
-	if (fscanf(f, "%ld", &mC) != 1) { fclose(f); return -1; }
-	fclose(f);
-	*outC = mC / 1000.0;
+	int count = bd->batch->count;
+	if (batch_flush(bd->batch, bd->tx) < 0) return -1;
+	if (count > 0) bd->sent++;
+	if (bd->jn) spill_consume_to(bd->jn, bd->jn_done);
+	if (bd->db) deadband_commit(bd->db);
 	return 0;
 }
 
-static int read_cpu_load_1min(double *outLoad)
+/* Count threshold, at tick boundaries so a tick's records stay together */
+static void bundler_tick_end(bundler_t *bd)
+{
+	if (bd->combine && bd->batch->count >= bd->per_bundle) (void)bundler_flush(bd);
+}
+
+/* Show a composed record, then send or batch it; s (NULL for a summary)
+ * is staged in the dead band once it is. 0, or -1 if it was not sent and
+ * could not be batched. */
+static int bundler_emit(bundler_t *bd, const char *rec, int len, int tick_end, const uint8_t *rec_calib,
+                        const sample_t *s)
 {
-	FILE *f = fopen("/proc/loadavg", "r");
-	if (!f) return -1;
-	double l1 = 0.0;
-	if (fscanf(f, "%lf", &l1) != 1) { fclose(f); return -1; }
-	fclose(f);
-	*outLoad = l1;
+	batch_t *b = bd->batch;
+
+	/* Print for user (keep visible output, as requested) */
+	if (bd->echo) {
+		if (bd->fmt != FMT_JSON) {
+			printf("%s (%d bytes):", (bd->fmt == FMT_RAW) ? "RAW" : "CBOR", len);
+			for (int i = 0; i < len; i++) printf(" %02x", (uint8_t)rec[i]);
+			printf("\n");
+		} else {
+			printf("JSON: %s\n", rec);
+		}
+		fflush(stdout);
+	}
+
+	if (!bd->combine) {
+		if (bptx_deliver(bd->tx, rec, len) < 0) return -1;
+		bd->sent++;
+		if (rec_calib) bd->calib_sent = 1;
+		if (bd->db && s) {
+			deadband_stage(bd->db, s, bd->replay);
+			deadband_commit(bd->db);
+		}
+		return 0;
+	}
+	/* Size threshold: flush first if this record would not fit */
+	if (batch_add(b, rec, len, bd->max_bytes) < 0) {
+		(void)bundler_flush(bd);
+		if (batch_add(b, rec, len, bd->max_bytes) < 0) {
+			putErrmsg("Batch full and BP failing; record dropped.", NULL);
+			return -1;
+		}
+	}
+	if (bd->db && s) deadband_stage(bd->db, s, bd->replay);
+	if (tick_end) bundler_tick_end(bd);
 	return 0;
 }
 
-/* ------------- Compose compact JSON into buf -------------- */
-/* Short header string + short keys: hdr="ts,t,p,h,ct,cl" */
-static int compose_json(char *buf, size_t buflen,
-                        int i2c_fd, bme280_calib_t *calib,
-                        const char *location)
+/* One summary record per sensor for the open window; 0, or -1 if one of
+ * them was lost */
+static int summary_flush(bundler_t *bd)
+{
+	summary_acc_t *acc = bd->sum;
+	summary_t sums[SENSORS_MAX + 1];
+	int n = 0, rc = 0;
+
+	for (int32_t sid = 0; sid <= SENSORS_MAX; sid++) {
+		if (summary_take(acc, sid, &sums[n]) == 0) n++;
+	}
+	acc->start = 0;
+	for (int i = 0; i < n; i++) {
+		char rec[512];
+		int len = (bd->fmt == FMT_CBOR) ? compose_summary_cbor(rec, sizeof rec, &sums[i], bd->location) :
+		                                  compose_summary_json(rec, sizeof rec, &sums[i], bd->location);
+		if (len < 0) {
+			putErrmsg("Failed to compose summary.", NULL);
+			continue;
+		}
+		if (bundler_emit(bd, rec, len, i == n - 1, NULL, NULL) < 0) rc = -1;
+	}
+	return rc;
+}
+
+/* One record from the ring: compose and emit it, fold it into the window
+ * statistics, or drop it inside the dead band. 0, or -1 if BP failed and
+ * a record was lost. */
+static int bundler_put(bundler_t *bd, const ring_item_t *it)
 {
-	int32_t t_raw, p_raw, h_raw;
-	if (bme280_read_raw(i2c_fd, &t_raw, &p_raw, &h_raw) < 0) return -1;
+	if (bd->db && !deadband_check(bd->db, &it->s, bd->replay)) {
+		if (it->tick_end) bundler_tick_end(bd);
+		return 0;
+	}
+	if (bd->sum) {
+		int64_t start = it->s.ts - it->s.ts % bd->sum->span;
+		int rc = 0;
+		if (bd->sum->start != 0 && start != bd->sum->start) rc = summary_flush(bd);
+		summary_add(bd->sum, &it->s);
+		return rc;
+	}
+
+	char rec[256];
+	/* Unbatched raw: calibration in every bundle until one is sent */
+	const uint8_t *rec_calib = (bd->fmt == FMT_RAW && !bd->combine && !bd->calib_sent) ?
+	                           bd->batch->sensors->sensor[0].calib_raw : NULL;
+
+	int len = compose_record(bd->fmt, rec, sizeof rec, &it->s, it->raw, rec_calib, bd->location);
+	if (len < 0) {
+		putErrmsg("Failed to compose payload.", NULL);
+		return 0;
+	}
+	return bundler_emit(bd, rec, len, it->tick_end, rec_calib, &it->s);
+}
 
-	double tC = bme280_comp_T(t_raw,  calib);
-	double pH = bme280_comp_P(p_raw,  calib);
-	double hR = bme280_comp_H(h_raw,  calib);
+/* What was queued on entry, then the age threshold; when final, whatever
+ * is left. A backlog behind a slow sender is cut short by a quit so the
+ * sampler can be stopped first; the final drain sends the rest. */
+static void bundler_drain(bundler_t *bd, ring_t *ring, int final)
+{
+	batch_t *b = bd->batch;
+	ring_item_t it;
 
-	double cpuC = 0.0, l1 = 0.0;
-	(void)read_cpu_temp_c(&cpuC);      /* ignore failures (leave 0.0) */
-	(void)read_cpu_load_1min(&l1);
+	for (size_t n = ring_count(ring); n > 0 && (final || _running(NULL)) && ring_pop(ring, &it) == 0; n--)
+		(void)bundler_put(bd, &it);
+	if (bd->sum && bd->sum->start != 0 && (final || (int64_t)time(NULL) >= bd->sum->start + bd->sum->span))
+		(void)summary_flush(bd);
+	if (b->count > 0 && (final || (bd->max_age > 0 && batch_age_sec(b) >= bd->max_age)))
+		(void)bundler_flush(bd);
+	/* The state only moves when a bundle goes out; it is written at most
+	 * every DEADBAND_SYNC_SEC, and at exit by deadband_close() */
+	if (bd->db && (final || (int64_t)time(NULL) - bd->db->synced >= DEADBAND_SYNC_SEC) &&
+	    deadband_sync(bd->db) < 0) {
+		putErrmsg("Can't write the dead-band state.", bd->db->path);
+		bd->db->path = NULL;            /* don't retry every tick */
+	}
+}
 
-	time_t ts = time(NULL);
+/* ------------- Journal: samples while BP is unavailable -------------- */
+/* If bp_attach() fails, records from the ring go to an append-only journal
+ * (the spill file format, one fixed-size ring_item_t per entry after the
+ * destination tag) and
+ * bp_attach() is retried every few seconds. Once BP is reachable the
+ * backlog is replayed as full batches (flushed only by -z) before normal
+ * sending resumes. An entry leaves the journal only once the bundle that
+ * carries it has been sent or spilled; a replay that a failed send cuts
+ * short is tried again later. A one-shot run journals its sample and
+ * exits; the next run that can attach replays it. */
+#define JOURNAL_DEFAULT_FILE "/var/cache/bpbme280/journal"
+#define JOURNAL_MAX_BYTES    (64u << 20)
+#define JOURNAL_RETRY_SEC    10
 
-	/* JSON with shorter field names, 1 decimal precision, single line */
-	int n;
-	if (location && location[0] != '\0') {
-		n = snprintf(
-			buf, buflen,
-			"{\"ts\":%ld,\"temp\":%.1f,\"press\":%.1f,\"humid\":%.1f,\"cpu_temp\":%.1f,\"load\":%.2f,\"loc\":\"%s\"}",
-			(long)ts, tC, pH, hR, cpuC, l1, location
-		);
+/* Move everything queued in the ring into the journal, synced once;
+ * records that do not fit are counted in *lost */
+static void journal_drain(spill_t *jn, ring_t *ring, const bptx_t *tx, uint64_t *lost)
+{
+	ring_item_t it;
+	while (ring_pop(ring, &it) == 0) {
+		if (bptx_queue_append(jn, tx->destEid, tx->ttl, &it, sizeof it) < 0) (*lost)++;
+	}
+	(void)spill_sync(jn);
+}
+
+/* The backlog, oldest first, in bundles as large as -z allows; a bundle
+ * never mixes records journaled for different destinations or TTLs. It
+ * has a batch and summary window of its own, so what a failed send leaves
+ * in them is simply dropped (it is still in the journal) and live samples
+ * never mix with it; the backlog's last window is closed at the end. The
+ * live batch is sent first, so what the dead band has staged on a failed
+ * replay is the backlog's alone and can be rolled back. */
+static void journal_replay(spill_t *jn, bundler_t *bd)
+{
+	static batch_t batch;
+	static summary_acc_t sum;
+	bundler_t rb = *bd;
+	bptx_t tx = *bd->tx;
+	char eid[BPTX_EID_MAX + 1], to[BPTX_EID_MAX + 1] = "";
+	const uint8_t *p, *data;
+	size_t len, data_len, pos = 0;
+	uint64_t n = 0;
+	int ttl, rc = 0;
+
+	if (bd->batch->count > 0 && bundler_flush(bd) < 0) {
+		printf("[?] journal: send failed; %zu record(s) kept for a later attempt\n", spill_count(jn));
+		fflush(stdout);
+		return;
+	}
+	batch.fmt = bd->batch->fmt;
+	batch.sensors = bd->batch->sensors;
+	batch.tagged = bd->batch->tagged;
+	batch_reset(&batch);
+	rb.batch = &batch;
+	if (bd->sum) {
+		memset(&sum, 0, sizeof sum);
+		sum.span = bd->sum->span;
+		rb.sum = &sum;
+	}
+	tx.destEid = to;
+	tx.ttl = 0;
+	rb.tx = &tx;
+	rb.echo = 0;
+	rb.combine = 1;
+	rb.per_bundle = INT_MAX;
+	rb.max_age = 0;
+	rb.sent = 0;
+	rb.jn = jn;
+	rb.jn_done = 0;
+	rb.replay = 1;
+	while (_running(NULL) && rc == 0 && spill_read(jn, &pos, &p, &len) == 0) {
+		ring_item_t it;
+		if (bptx_queue_parse(p, len, eid, &ttl, &data, &data_len) == 0 &&
+		    data_len == sizeof it) {       /* else: written by another build */
+			/* Another destination: what is batched goes out first */
+			if (strcmp(eid, to) != 0 || ttl != tx.ttl) {
+				if (rb.sum && rb.sum->start != 0) rc = summary_flush(&rb);
+				if (rc == 0) rc = bundler_flush(&rb);
+				if (rc < 0) break;
+				memcpy(to, eid, sizeof to);
+				tx.ttl = ttl;
+			}
+			memcpy(&it, data, sizeof it);
+			if ((rc = bundler_put(&rb, &it)) == 0) n++;
+		}
+		if (rc == 0) rb.jn_done = pos;
+	}
+	if (rc == 0 && rb.sum && rb.sum->start != 0) rc = summary_flush(&rb);
+	if (rc == 0) rc = bundler_flush(&rb);
+	bd->sent += rb.sent;
+	bd->tx->spilled = tx.spilled;
+	bd->tx->replayed = tx.replayed;
+	if (rc < 0) {
+		batch_reset(&batch);
+		if (bd->db) deadband_rollback(bd->db);
+		printf("[?] journal: send failed; %zu record(s) kept for a later attempt\n", spill_count(jn));
 	} else {
-		n = snprintf(
-			buf, buflen,
-			"{\"ts\":%ld,\"temp\":%.1f,\"press\":%.1f,\"humid\":%.1f,\"cpu_temp\":%.1f,\"load\":%.2f}",
-			(long)ts, tC, pH, hR, cpuC, l1
-		);
+		printf("[i] journal: replayed %llu record(s) in %d bundle(s)\n", (unsigned long long)n, rb.sent);
 	}
-	return (n > 0 && (size_t)n < buflen) ? n : -1;
+	fflush(stdout);
 }
 
-/* -------------------- Main: one-shot send ------------------- */
+/* ------------- Metrics file (-metrics) -------------- */
+/* At most every METRICS_PERIOD_SEC, or now when final; a file that can't
+ * be written is reported once and given up */
+static void metrics_flush(const char **path, const ring_t *ring, int final)
+{
+	static time_t last;
+	time_t now = time(NULL);
+
+	if (!*path || (!final && now - last < METRICS_PERIOD_SEC)) return;
+	last = now;
+	metrics_set(MC_RING_DROPPED, ring_dropped(ring));
+	if (metrics_write(*path) < 0) {
+		putErrmsg("Can't write the metrics file.", *path);
+		*path = NULL;
+	}
+}
+
+/* ------------- Sensor settings (-preset, -osrs, -filter, -standby) -------------- */
+/* The preset first, then single values on top of it. 0, or -1 after
+ * printing what is wrong. */
+static int settings_apply(bme280_settings_t *st, const char *preset, const char *osrs,
+                          const char *filter, const char *standby, int mode)
+{
+	if (preset && bme280_preset(preset, st) < 0) {
+		PUTS("[?] preset must be weather, humidity, indoor or gaming");
+		return -1;
+	}
+	if (osrs) {
+		unsigned t, p, h;
+		int ct, cp, ch;
+		if (sscanf(osrs, "%u,%u,%u", &t, &p, &h) != 3 || t == 0 ||
+		    (ct = bme280_osrs_code(t)) < 0 || (cp = bme280_osrs_code(p)) < 0 ||
+		    (ch = bme280_osrs_code(h)) < 0) {
+			PUTS("[?] -osrs<t>,<p>,<h>: each 0 (skip), 1, 2, 4, 8 or 16; temperature can't be skipped");
+			return -1;
+		}
+		st->osrs_t = (uint8_t)ct;
+		st->osrs_p = (uint8_t)cp;
+		st->osrs_h = (uint8_t)ch;
+	}
+	if (filter) {
+		int c = bme280_filter_code((unsigned)atoi(filter));
+		if (c < 0) {
+			PUTS("[?] -filter must be 0 (off), 2, 4, 8 or 16");
+			return -1;
+		}
+		st->filter = (uint8_t)c;
+	}
+	if (standby) {
+		int c = bme280_standby_code((unsigned)lround(atof(standby) * 1000.0));
+		if (c < 0) {
+			PUTS("[?] -standby must be 0.5, 10, 20, 62.5, 125, 250, 500 or 1000 (ms)");
+			return -1;
+		}
+		st->t_sb = (uint8_t)c;
+	}
+	if (mode >= 0) st->mode = (uint8_t)mode;
+	return 0;
+}
+
+static void settings_report(const bme280_settings_t *st)
+{
+	char os[3][8], iir[8];
+	const uint8_t code[3] = { st->osrs_t, st->osrs_p, st->osrs_h };
+	for (int k = 0; k < 3; k++) {
+		if (code[k]) snprintf(os[k], sizeof os[k], "x%u", bme280_osrs_factor(code[k]));
+		else         snprintf(os[k], sizeof os[k], "skip");
+	}
+	if (st->filter) snprintf(iir, sizeof iir, "%u", bme280_filter_coef(st->filter));
+	else            snprintf(iir, sizeof iir, "off");
+	unsigned odr = bme280_max_odr_mhz(st);
+	printf("[i] BME280: %s mode, oversampling T %s P %s H %s, filter %s",
+	       (st->mode == BME280_MODE_NORMAL) ? "normal" : "forced", os[0], os[1], os[2], iir);
+	if (st->mode == BME280_MODE_NORMAL) printf(", standby %g ms", bme280_standby_us(st->t_sb) / 1000.0);
+	printf("; measurement <= %.2f ms, max ODR %u.%02u Hz\n",
+	       bme280_meas_time_us(st) / 1000.0, odr / 1000, odr % 1000 / 10);
+	fflush(stdout);
+}
+
+/* -------------------- Main: one-shot or periodic send ------------------- */
 #define DEFAULT_TTL 300
 #define DEFAULT_I2C_DEV "/dev/i2c-1"
 
@@ -265,21 +847,127 @@ int main(int argc, char **argv)
 	int ttl = DEFAULT_TTL;
 	const char *i2c_dev = DEFAULT_I2C_DEV;
 	int i2c_addr = 0x76;
+	const char *spi_dev = NULL;   /* -s: SPI instead of -d/-a */
 	const char *location = NULL;
+	int interval = 0;             /* seconds; 0 = one-shot */
+	int stream_hz = 0;            /* samples/s; 0 = no streaming */
+	const char *cache_dir = CALCACHE_DEFAULT_DIR;   /* NULL = disabled */
+	const char *spill_path = SPILL_DEFAULT_FILE;    /* NULL = disabled */
+	static spill_t spill;
+	const char *journal_path = JOURNAL_DEFAULT_FILE;   /* NULL = disabled */
+	static spill_t journal;
+	int batch_n = 1;              /* samples per bundle */
+	int summary_sec = 0;          /* summary window; 0 = send every sample */
+	static summary_acc_t summary;
+	const char *deadband_spec = NULL;   /* NULL = send every reading */
+	int heartbeat = DEADBAND_HEARTBEAT_SEC;
+	const char *state_path = DEADBAND_DEFAULT_FILE;   /* NULL = memory only */
+	const char *metrics_path = NULL;    /* -metrics: Prometheus textfile */
+	static deadband_t deadband;
+	deadband_t *db = NULL;              /* deadband, once opened */
+	int batch_age = 0;            /* seconds; 0 = no age limit */
+	int batch_bytes = BATCH_DEFAULT_BYTES;
+	static batch_t batch;
+	int fmt = FMT_JSON;
+	static sensors_t sensors;
+	static sampler_t sampler;
+	bme280_settings_t settings = {
+		.osrs_t = 1, .osrs_p = 1, .osrs_h = 1,   /* x1 */
+		.filter = 0,                            /* off */
+		.t_sb = 4,                              /* 500 ms */
+		.mode = BME280_MODE_FORCED,
+	};
+	/* Sensor settings from the command line, applied after the preset */
+	const char *preset = NULL, *osrs = NULL, *filter = NULL, *standby = NULL;
+	int mode = -1;
 
 	if (argc < 3) {
-		PUTS("Usage: bpbme280 <sourceEID> <destEID> [-t<ttl>] [-a0x76|0x77] [-d/dev/i2c-X] [-loc<location>]");
+		PUTS("Usage: bpbme280 <sourceEID> <destEID> [-t<ttl>] [-a0x76|0x77] [-d/dev/i2c-X] [-s/dev/spidevX.Y] [-loc<location>] [-i<seconds>] [-mforced|normal] [-cache<dir>|-nocache] [-spill<file>|-nospill] [-journal<file>|-nojournal] [-sensor<dev>@<addr>|<dev>@spi ...] [-n<samples>] [-w<seconds>] [-z<bytes>] [-fjson|cbor|raw] [-r<hz>] [-summary<seconds>] [-deadband<t>,<p>,<h>[,<ct>,<l>]] [-heartbeat<seconds>] [-state<file>|-nostate] [-preset<weather|humidity|indoor|gaming>] [-osrs<t>,<p>,<h>] [-filter<coef>] [-standby<ms>] [-metrics<file>]");
 		return 0;
 	}
 	sourceEid = argv[1];
 	destEid = argv[2];
+	if (strlen(destEid) == 0 || strlen(destEid) > BPTX_EID_MAX) {
+		printf("[?] bad destination EID (1 to %d characters)\n", BPTX_EID_MAX);
+		return 0;
+	}
+	sensors_init(&sensors);
 	for (int i = 3; i < argc; i++) {
-		if (argv[i][0] == '-' && argv[i][1] == 't') {
+		if (strncmp(argv[i], "-sensor", 7) == 0) {
+			if (sensors_add_spec(&sensors, argv[i] + 7) < 0) {
+				printf("[?] bad sensor '%s' (want <dev>@<addr> or <dev>@spi, at most %d)\n", argv[i] + 7, SENSORS_MAX);
+				return 0;
+			}
+		} else if (strncmp(argv[i], "-cache", 6) == 0) {
+			cache_dir = argv[i] + 6;
+		} else if (strcmp(argv[i], "-nocache") == 0) {
+			cache_dir = NULL;
+		} else if (strncmp(argv[i], "-summary", 8) == 0) {
+			summary_sec = atoi(argv[i] + 8);
+		} else if (strncmp(argv[i], "-deadband", 9) == 0) {
+			deadband_spec = argv[i] + 9;
+		} else if (strncmp(argv[i], "-heartbeat", 10) == 0) {
+			heartbeat = atoi(argv[i] + 10);
+		} else if (strncmp(argv[i], "-state", 6) == 0) {
+			state_path = argv[i] + 6;
+		} else if (strcmp(argv[i], "-nostate") == 0) {
+			state_path = NULL;
+		} else if (strncmp(argv[i], "-metrics", 8) == 0) {
+			metrics_path = (argv[i][8] != '\0') ? argv[i] + 8 : NULL;
+		} else if (strncmp(argv[i], "-preset", 7) == 0) {
+			preset = argv[i] + 7;
+		} else if (strncmp(argv[i], "-osrs", 5) == 0) {
+			osrs = argv[i] + 5;
+		} else if (strncmp(argv[i], "-filter", 7) == 0) {
+			filter = argv[i] + 7;
+		} else if (strncmp(argv[i], "-standby", 8) == 0) {
+			standby = argv[i] + 8;
+		} else if (strncmp(argv[i], "-spill", 6) == 0) {
+			spill_path = argv[i] + 6;
+		} else if (strcmp(argv[i], "-nospill") == 0) {
+			spill_path = NULL;
+		} else if (strncmp(argv[i], "-journal", 8) == 0) {
+			journal_path = argv[i] + 8;
+		} else if (strcmp(argv[i], "-nojournal") == 0) {
+			journal_path = NULL;
+		} else if (argv[i][0] == '-' && argv[i][1] == 't') {
 			ttl = atoi(argv[i] + 2);
 		} else if (argv[i][0] == '-' && argv[i][1] == 'a') {
 			i2c_addr = (int)strtol(argv[i] + 2, NULL, 0);
 		} else if (argv[i][0] == '-' && argv[i][1] == 'd') {
 			i2c_dev = argv[i] + 2;
+		} else if (argv[i][0] == '-' && argv[i][1] == 's') {
+			spi_dev = argv[i] + 2;
+		} else if (argv[i][0] == '-' && argv[i][1] == 'i') {
+			interval = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1] == 'r') {
+			stream_hz = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1] == 'n') {
+			batch_n = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1] == 'w') {
+			batch_age = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1] == 'z') {
+			batch_bytes = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1] == 'f') {
+			if (strcmp(argv[i] + 2, "json") == 0) {
+				fmt = FMT_JSON;
+			} else if (strcmp(argv[i] + 2, "cbor") == 0) {
+				fmt = FMT_CBOR;
+			} else if (strcmp(argv[i] + 2, "raw") == 0) {
+				fmt = FMT_RAW;
+			} else {
+				PUTS("[?] format must be json, cbor or raw");
+				return 0;
+			}
+		} else if (argv[i][0] == '-' && argv[i][1] == 'm') {
+			if (strcmp(argv[i] + 2, "normal") == 0) {
+				mode = BME280_MODE_NORMAL;
+			} else if (strcmp(argv[i] + 2, "forced") == 0) {
+				mode = BME280_MODE_FORCED;
+			} else {
+				PUTS("[?] mode must be forced or normal");
+				return 0;
+			}
 		} else if (strncmp(argv[i], "-loc", 4) == 0) {
 			location = argv[i] + 4;
 		}
@@ -289,110 +977,299 @@ int main(int argc, char **argv)
 		PUTS("[?] ttl must be > 0");
 		return 0;
 	}
-
-	/* Attach to BP & start attendant (same pattern as bpsource) */
-	if (bp_attach() < 0) {
-		putErrmsg("Can't attach to BP.", NULL);
+	if (settings_apply(&settings, preset, osrs, filter, standby, mode) < 0) return 0;
+	if (interval < 0) {
+		PUTS("[?] interval must be >= 0");
 		return 0;
 	}
-	ReqAttendant attendant;
-	if (ionStartAttendant(&attendant)) {
-		putErrmsg("Can't initialize blocking transmission.", NULL);
-		bp_detach();
+	if (batch_n < 1 || batch_age < 0 || batch_bytes < 64 || batch_bytes > BATCH_BUF_MAX) {
+		printf("[?] need -n >= 1, -w >= 0 and 64 <= -z <= %d\n", BATCH_BUF_MAX);
 		return 0;
 	}
-	_attendant(&attendant);
-	Sdr sdr = bp_get_sdr();
-
-	/* Open I2C and set slave address */
-	int i2c_fd = open(i2c_dev, O_RDWR);
-	if (i2c_fd < 0) {
-		fprintf(stderr, "Failed to open %s: %s\n", i2c_dev, strerror(errno));
-		goto cleanup;
+	int batching = (batch_n > 1 || batch_age > 0);
+	if (stream_hz < 0 || stream_hz > STREAM_MAX_HZ || (stream_hz && interval)) {
+		printf("[?] -r needs 1..%d samples/s and no -i\n", STREAM_MAX_HZ);
+		return 0;
 	}
-	if (ioctl(i2c_fd, I2C_SLAVE, i2c_addr) < 0) {
-		fprintf(stderr, "Failed to set I2C addr 0x%02X: %s\n", i2c_addr, strerror(errno));
-		goto cleanup;
+	if (batching && interval == 0 && stream_hz == 0) {
+		PUTS("[?] batching (-n/-w) needs a sampling interval (-i)");
+		return 0;
 	}
-
-	/* Confirm BME280 presence (not fatal if mismatched; just warn) */
-	uint8_t chip = 0;
-	if (i2c_read_reg(i2c_fd, REG_ID, &chip) < 0 || chip != BME280_CHIP_ID) {
-		fprintf(stderr, "[?] Unexpected chip-id 0x%02X (expected 0x%02X). Check wiring/address.\n",
-		        chip, BME280_CHIP_ID);
+	if (summary_sec < 0 || (summary_sec && interval == 0 && stream_hz == 0) ||
+	    (summary_sec && summary_sec < interval)) {
+		PUTS("[?] -summary needs -i or -r and a window of at least one interval");
+		return 0;
 	}
+	if (summary_sec && fmt == FMT_RAW) {
+		PUTS("[?] summaries are computed from compensated values; use -fjson or -fcbor");
+		return 0;
+	}
+	if (deadband_spec && (deadband_parse(&deadband, deadband_spec) < 0 || heartbeat < 0)) {
+		PUTS("[?] need -deadband<temp>,<press>,<humid>[,<cpu_temp>,<load>] (>= 0, at least one) and -heartbeat >= 0");
+		return 0;
+	}
+	if (deadband_spec && summary_sec) {
+		PUTS("[?] -deadband filters single readings; it does not combine with -summary");
+		return 0;
+	}
+	if (sensors.n == 0 && spi_dev) (void)sensors_add(&sensors, spi_dev, BME280_ADDR_SPI);
+	if (sensors.n == 0) (void)sensors_add(&sensors, i2c_dev, (uint16_t)i2c_addr);
+	if (stream_hz && sensors.n > 1) {
+		PUTS("[?] streaming (-r) reads a single sensor");
+		return 0;
+	}
+	if (stream_hz) {
+		settings.mode = BME280_MODE_NORMAL;
+		settings.t_sb = 0;                      /* 0.5 ms */
+	}
+	settings_report(&settings);
+	if (stream_hz) {
+		unsigned odr_hz = bme280_max_odr_mhz(&settings) / 1000;
+		printf("[i] streaming at %d Hz%s\n", stream_hz,
+		       (unsigned)stream_hz > odr_hz ? "; faster than the sensor, readings repeat" : "");
+	}
+	int tagged = (sensors.n > 1);
+	/* Records go through the batch; a stream of samples always bundles */
+	int combine = (batching || tagged || (stream_hz && !summary_sec));
+
+	/* CPU stats files stay open for the whole run */
+	cpustat_t cpustat;
+	cpustat_open(&cpustat);
+	bptx_t tx = { 0, NULL, destEid, ttl, NULL, NULL, spill_path, 0, 0 };
+	BpSAP sourceSap = NULL;
+	spill_t *jn = NULL;           /* journal, when open */
+	uint64_t jlost = 0;
+	int attached = 0;
 
-	/* Read calibration & configure sensor */
-	bme280_calib_t calib;
-	if (bme280_read_calib(i2c_fd, &calib) < 0) {
-		putErrmsg("Failed to read BME280 calibration.", NULL);
+	/* Buses, calibration (cached) and configuration of every sensor */
+	/* Raw payloads skip compensation unless the dead band needs the values */
+	if (sensors_open(&sensors, &settings, cache_dir, fmt != FMT_RAW || deadband_spec) < 0) {
+		putErrmsg("Failed to set up BME280 sensor(s).", NULL);
 		goto cleanup;
 	}
-	if (bme280_configure(i2c_fd) < 0) {
-		putErrmsg("Failed to configure BME280.", NULL);
+	if (tagged) {
+		for (int k = 0; k < sensors.n; k++) {
+			if (sensors.sensor[k].addr == BME280_ADDR_SPI) {
+				printf("[i] sid %d: %s (SPI)\n", sensors.sensor[k].sid, sensors.sensor[k].dev);
+				continue;
+			}
+			printf("[i] sid %d: %s@0x%02X\n", sensors.sensor[k].sid, sensors.sensor[k].dev,
+			       sensors.sensor[k].addr);
+		}
+	}
+
+	/* Raw format: the receiver compensates with the NVM images */
+	batch.fmt = fmt;
+	batch.sensors = &sensors;
+	batch.tagged = tagged;
+	batch_reset(&batch);
+
+	sampler.sensors = &sensors;
+	sampler.cs = &cpustat;
+	sampler.interval = interval;
+	sampler.hz = stream_hz;
+	sampler.tagged = tagged;
+	if (ring_init(&sampler.ring, RING_CAP) < 0) {
+		putErrmsg("No memory for the sample ring.", NULL);
 		goto cleanup;
 	}
 
-	/* Short delay and poll status to ensure a fresh measurement */
-	usleep(100000);
-	for (int i = 0; i < 5; i++) {
-		uint8_t st = 0;
-		if (i2c_read_reg(i2c_fd, REG_STATUS, &st) == 0 && (st & 0x08) == 0) break;
-		usleep(20000);
+	bundler_t bd = {
+		.fmt = fmt, .location = location, .echo = (stream_hz == 0 || summary_sec), .combine = combine,
+		/* -n counts ticks (or summaries) of all sensors; a stream defaults
+		 * to one second's worth */
+		.per_bundle = (stream_hz && !summary_sec) ? (batch_n > 1 ? batch_n : stream_hz) :
+		              (batching ? batch_n * sensors.n : 1),
+		.max_age = batch_age, .max_bytes = batch_bytes, .batch = &batch, .tx = &tx,
+	};
+	if (summary_sec) {
+		summary.span = summary_sec;
+		bd.sum = &summary;
+		printf("[i] sending a min/max/mean/sd summary every %d s\n", summary_sec);
+	}
+	if (deadband_spec) {
+		deadband.heartbeat = heartbeat;
+		const char *path = (state_path && state_path[0] != '\0') ? state_path : NULL;
+		if (deadband_open(&deadband, path, destEid) < 0) {
+			printf("[?] dead-band state %s in use by another bpbme280; kept in memory only\n", path);
+		}
+		bd.db = db = &deadband;
+		printf("[i] sending on change beyond %s (temp,press,humid,cpu_temp,load), heartbeat %d s\n",
+		       deadband_spec, heartbeat);
 	}
 
-	/* Compose compact JSON payload */
-	char json[256];
-	int len = compose_json(json, sizeof json, i2c_fd, &calib, location);
-	if (len < 0) {
-		putErrmsg("Failed to read/compose JSON.", NULL);
-		goto cleanup;
+	/* Stop cleanly on SIGINT (ctrl-c) and SIGTERM (systemd stop) */
+	isignal(SIGINT, handleQuit);
+	isignal(SIGTERM, handleQuit);
+
+	if (journal_path && journal_path[0] != '\0') {
+		if (spill_open(&journal, journal_path, JOURNAL_MAX_BYTES) == 0) {
+			jn = &journal;
+		} else {
+			printf("[?] can't open journal %s (%s); samples are lost while BP is down\n",
+			       journal_path, errno == EWOULDBLOCK ? "in use by another bpbme280" : strerror(errno));
+		}
 	}
 
-	/* Print for user (keep visible output, as requested) */
-	printf("JSON: %s\n", json);
-	fflush(stdout);
+	/* Attach to BP (same pattern as bpsource); until it is reachable,
+	 * sampling goes on into the journal */
+	attached = (bp_attach() >= 0);
+	if (!attached) {
+		if (!jn) {
+			putErrmsg("Can't attach to BP.", NULL);
+			goto cleanup;
+		}
+		printf("[?] BP unavailable: journaling samples to %s\n", journal_path);
+		fflush(stdout);
+		if (interval == 0 && stream_hz == 0) {
+			(void)sampler_tick(&sampler);
+			journal_drain(jn, &sampler.ring, &tx, &jlost);
+			if (jlost == 0) PUTS("[i] bpbme280 journaled one sample and will exit.");
+			goto cleanup;
+		}
+		if (sampler_start(&sampler) < 0) {
+			putErrmsg("Can't start the sampling thread.", NULL);
+			goto cleanup;
+		}
+		struct timespec last_try, now;
+		clock_gettime(CLOCK_MONOTONIC, &last_try);
+		while (_running(NULL) && !attached) {
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += 1;
+			(void)sem_timedwait(&sampler.avail, &until);
+			journal_drain(jn, &sampler.ring, &tx, &jlost);
+			metrics_flush(&metrics_path, &sampler.ring, 0);
 
-	/* Create ZCO and send a single bundle, then exit */
-	CHKZERO(sdr_begin_xn(sdr));
-	Object extent = sdr_malloc(sdr, len);
-	if (extent) { sdr_write(sdr, extent, json, len); }
-	if (sdr_end_xn(sdr) < 0) {
-		putErrmsg("No space for ZCO extent.", NULL);
-		goto cleanup;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec - last_try.tv_sec >= JOURNAL_RETRY_SEC) {
+				last_try = now;
+				attached = (bp_attach() >= 0);
+			}
+		}
+		if (!attached) {
+			sampler_stop(&sampler);
+			journal_drain(jn, &sampler.ring, &tx, &jlost);
+			if (stream_hz) stream_report(&sampler);
+			goto cleanup;
+		}
+		printf("[i] BP reachable; %zu journaled record(s) to send\n", spill_count(jn));
+		fflush(stdout);
 	}
 
-	Object zco = ionCreateZco(ZcoSdrSource, extent, 0, len,
-	                          BP_STD_PRIORITY, 0, ZcoOutbound, &attendant);
-	if (zco == 0 || zco == (Object)ERROR) {
-		putErrmsg("Can't create ZCO extent.", NULL);
+	/* Attendant for blocking sends (same pattern as bpsource) */
+	ReqAttendant attendant;
+	if (ionStartAttendant(&attendant)) {
+		putErrmsg("Can't initialize blocking transmission.", NULL);
 		goto cleanup;
 	}
+	_attendant(&attendant);
+	tx.sdr = bp_get_sdr();
+	tx.attendant = &attendant;
 
-	/* Open source SAP for sending */
-	BpSAP sourceSap;
+	/* Open source SAP for sending; kept open across ticks */
 	if (bp_open_source(sourceEid, &sourceSap, 0) < 0)
 	{
 		putErrmsg("Can't open source endpoint.", sourceEid);
+		sourceSap = NULL;
 		goto cleanup;
 	}
 
-	Object newBundle;
-	if (bp_send(sourceSap, destEid, NULL, ttl, BP_STD_PRIORITY,
-	            NoCustodyRequested, 0, 0, NULL, zco, &newBundle) < 1)
-	{
-		putErrmsg("bpbme280 can't send ADU.", NULL);
-		bp_close(sourceSap);
+	tx.sap = sourceSap;
+	if (spill_path && spill_path[0] != '\0') {
+		if (spill_open(&spill, spill_path, SPILL_MAX_BYTES) == 0) {
+			tx.spill = &spill;
+			tx.attendant = NULL;            /* never block; spill instead */
+			if (spill_count(&spill) > 0) {
+				printf("[i] spill: %zu payload(s) from an earlier run in %s\n",
+				       spill_count(&spill), spill_path);
+			}
+		} else {
+			printf("[?] can't open spill file %s (%s); sends block when ION is full\n",
+			       spill_path, errno == EWOULDBLOCK ? "in use by another bpbme280" : strerror(errno));
+		}
+	}
+
+	/* Samples journaled while BP was down, in this run or an earlier one */
+	time_t jn_try = time(NULL);
+	if (jn && spill_count(jn) > 0) journal_replay(jn, &bd);
+
+	if (interval == 0 && stream_hz == 0) {
+		/* One-shot: a single tick on this thread */
+		int before = bd.sent;
+		(void)sampler_tick(&sampler);
+		bundler_drain(&bd, &sampler.ring, 1);
+		if (bd.sent > before && tx.spilled) PUTS("[i] bpbme280 queued one bundle in the spill file and will exit.");
+		else if (bd.sent > before) PUTS("[i] bpbme280 sent one bundle and will exit.");
+		else if (bd.db && bd.db->suppressed) PUTS("[i] bpbme280 reading within the dead band; nothing sent.");
+		goto cleanup;
+	}
+
+	if (!sampler.started && sampler_start(&sampler) < 0) {
+		putErrmsg("Can't start the sampling thread.", NULL);
 		goto cleanup;
 	}
+	uint64_t dropped = 0;
+	while (_running(NULL)) {
+		/* Woken after every tick, at least once a second for -w */
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += 1;
+		(void)sem_timedwait(&sampler.avail, &until);
+		bundler_drain(&bd, &sampler.ring, 0);
+		bptx_replay(&tx);
+		metrics_flush(&metrics_path, &sampler.ring, 0);
+
+		/* What a failed replay left in the journal */
+		if (jn && spill_count(jn) > 0 && time(NULL) - jn_try >= JOURNAL_RETRY_SEC) {
+			jn_try = time(NULL);
+			journal_replay(jn, &bd);
+		}
 
-	bp_close(sourceSap);
+		if (ring_dropped(&sampler.ring) != dropped) {
+			dropped = ring_dropped(&sampler.ring);
+			printf("[?] ring full (BP backpressure): %llu record(s) dropped so far\n",
+			       (unsigned long long)dropped);
+			fflush(stdout);
+		}
+	}
+	sampler_stop(&sampler);
 
-	PUTS("[i] bpbme280 sent one bundle and will exit.");
+	/* Don't leave collected samples behind on shutdown */
+	bundler_drain(&bd, &sampler.ring, 1);
+	if (stream_hz) stream_report(&sampler);
+	else ring_report(&sampler.ring);
+	if (bd.db) {
+		printf("[i] dead band: %llu reading(s) not sent\n", (unsigned long long)bd.db->suppressed);
+	}
+	printf("[i] bpbme280 stopping after %d bundle(s).\n", bd.sent);
 
 cleanup:
+	sampler_stop(&sampler);
+	metrics_flush(&metrics_path, &sampler.ring, 1);
+	if (jn) {
+		if (jlost > 0) {
+			printf("[?] journal full: %llu record(s) lost\n", (unsigned long long)jlost);
+		}
+		if (spill_count(jn) > 0) {
+			printf("[i] journal: %zu record(s) kept in %s for the next run\n",
+			       spill_count(jn), journal_path);
+		}
+		spill_close(jn);
+	}
+	if (tx.spill) {
+		if (spill_count(tx.spill) > 0) {
+			printf("[i] spill: %zu payload(s) (%zu bytes) kept in %s for the next run\n",
+			       spill_count(tx.spill), spill_bytes(tx.spill), spill_path);
+		}
+		spill_close(tx.spill);
+	}
+	if (db) deadband_close(db);
+	if (sourceSap) { bp_close(sourceSap); }
 	if (_attendant(NULL)) { ionStopAttendant(_attendant(NULL)); }
-	bp_detach();
-	if (i2c_fd >= 0) close(i2c_fd);
+	if (attached) bp_detach();
+	sensors_close(&sensors);
+	cpustat_close(&cpustat);
+	ring_free(&sampler.ring);
 	return 0;
 }
@@ -0,0 +1,144 @@
+/*
+ * bpbme280dec.c: Convert a bpbme280 CBOR payload back to its JSON form.
+ *
+ * Reads one bundle payload (a CBOR or raw-ADC record, or a batch array of
+ * records, see record.h) from a file or stdin and prints the same
+ * single-line JSON that bpbme280 -fjson would have sent, so existing
+ * consumers keep working. Raw records are compensated here (bme280rx.h).
+ * JSON payloads are passed through unchanged.
+ *
+ * Unbatched -fraw sessions carry the calibration only in their first
+ * bundle; -c names a file where it is kept (per sensor) between
+ * invocations.
+ *
+ * Usage:
+ *   bpbme280dec [-c<calibfile>] [payload-file]
+ *
+ * Build:
+ *   gcc -O2 -Wall -Wextra -std=c11 bpbme280dec.c bme280rx.c record.c jsonw.c cbor.c \
+ *       libbme280.a -o bpbme280dec
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bme280rx.h"
+#include "cbor.h"
+#include "record.h"
+
+#define MAX_PAYLOAD 65536
+
+typedef struct {
+	FILE *out;
+	int   count;
+} emit_t;
+
+/* One record -> {"ts":..,"temp":..,...} exactly as compose_json() (or
+ * compose_summary_json()) writes it */
+static int emit_record(const bme280rx_rec_t *rec, void *arg)
+{
+	emit_t *e = arg;
+	char loc[256], json[768];
+	size_t n = 0;
+	if (rec->loc) {
+		n = rec->loc_len < sizeof loc - 1 ? rec->loc_len : sizeof loc - 1;
+		memcpy(loc, rec->loc, n);
+	}
+	loc[n] = '\0';
+
+	if (rec->summary) {
+		if (compose_summary_json(json, sizeof json, &rec->sum, loc) < 0) return -1;
+	} else if (compose_json(json, sizeof json, &rec->s, loc) < 0) {
+		return -1;
+	}
+	if (e->count++) fputc(',', e->out);
+	fputs(json, e->out);
+	return 0;
+}
+
+/* Calibration file: one (sid byte, BME280_CALIB_LEN bytes) entry per sensor */
+static int load_calib(const char *path, bme280rx_t *rx)
+{
+	uint8_t ent[1 + BME280_CALIB_LEN];
+	FILE *f = fopen(path, "rb");
+	if (!f) return -1;
+	while (fread(ent, 1, sizeof ent, f) == sizeof ent) {
+		(void)bme280rx_set_calib(rx, ent[0], ent + 1);
+	}
+	fclose(f);
+	return 0;
+}
+
+static int store_calib(const char *path, const bme280rx_t *rx)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) return -1;
+	int ok = 1;
+	for (int sid = 0; sid <= BME280RX_MAX_SID; sid++) {
+		if (!rx->cal[sid].have) continue;
+		uint8_t id = (uint8_t)sid;
+		ok &= fwrite(&id, 1, 1, f) == 1 &&
+		      fwrite(rx->cal[sid].raw, 1, BME280_CALIB_LEN, f) == BME280_CALIB_LEN;
+	}
+	if (fclose(f) != 0) ok = 0;
+	return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *calib_file = NULL;
+	const char *payload_file = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-c", 2) == 0) {
+			calib_file = argv[i] + 2;
+		} else {
+			payload_file = argv[i];
+		}
+	}
+
+	FILE *in = stdin;
+	if (payload_file && (in = fopen(payload_file, "rb")) == NULL) {
+		perror(payload_file);
+		return 1;
+	}
+
+	static uint8_t buf[MAX_PAYLOAD];
+	size_t len = fread(buf, 1, sizeof buf, in);
+	if (in != stdin) fclose(in);
+	if (len == 0) {
+		fprintf(stderr, "bpbme280dec: empty payload\n");
+		return 1;
+	}
+
+	/* Already JSON: pass through */
+	if (buf[0] == '{' || buf[0] == '[') {
+		fwrite(buf, 1, len, stdout);
+		if (buf[len - 1] != '\n') fputc('\n', stdout);
+		return 0;
+	}
+
+	bme280rx_t rx;
+	bme280rx_init(&rx);
+	if (calib_file) (void)load_calib(calib_file, &rx);
+
+	emit_t e = { .out = stdout, .count = 0 };
+	int is_batch = ((buf[0] >> 5) != CBOR_MAP);
+	if (is_batch) fputc('[', stdout);
+	int rc = bme280rx_decode(&rx, buf, len, &is_batch, emit_record, &e);
+	if (is_batch && rc >= 0) fputs("]\n", stdout);
+	else if (rc > 0) fputc('\n', stdout);
+
+	if (rc == BME280RX_ERR_NOCALIB) {
+		fprintf(stderr, "bpbme280dec: raw payload without calibration (use -c<calibfile>)\n");
+		return 1;
+	}
+	if (rc < 0) {
+		fprintf(stderr, "bpbme280dec: malformed CBOR payload\n");
+		return 1;
+	}
+	if (calib_file && rx.calib_updated && store_calib(calib_file, &rx) < 0) {
+		perror(calib_file);
+	}
+	return 0;
+}
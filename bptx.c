@@ -0,0 +1,138 @@
+/*
+ * bptx.c: Payload send path and spill queue (see bptx.h).
+ *
+ * Queue entry layout: bptx_tag_t | destination EID (no NUL) | payload.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "bptx.h"
+#include "metrics.h"
+
+typedef struct {
+	int32_t  ttl;
+	uint16_t eid_len;            /* EID bytes that follow, no NUL */
+	uint16_t reserved;
+} bptx_tag_t;
+
+int bptx_queue_append(spill_t *sp, const char *eid, int ttl, const void *buf, size_t len)
+{
+	bptx_tag_t tag = { ttl, (uint16_t)strlen(eid), 0 };
+	struct iovec iov[3] = {
+		{ &tag, sizeof tag }, { (void *)eid, tag.eid_len }, { (void *)buf, len },
+	};
+	return spill_appendv(sp, iov, 3);
+}
+
+int bptx_queue_parse(const uint8_t *p, size_t len, char *eid, int *ttl,
+                     const uint8_t **data, size_t *data_len)
+{
+	bptx_tag_t tag;
+	if (len < sizeof tag) return -1;
+	memcpy(&tag, p, sizeof tag);
+	if (tag.eid_len == 0 || tag.eid_len > BPTX_EID_MAX || tag.ttl <= 0 ||
+	    len < sizeof tag + tag.eid_len) return -1;
+	memcpy(eid, p + sizeof tag, tag.eid_len);
+	eid[tag.eid_len] = '\0';
+	*ttl = tag.ttl;
+	*data = p + sizeof tag + tag.eid_len;
+	*data_len = len - sizeof tag - tag.eid_len;
+	return 0;
+}
+
+int bptx_send(const bptx_t *tx, const char *eid, int ttl, const void *buf, int len)
+{
+	Sdr sdr = tx->sdr;
+	int64_t t0 = metrics_now();
+	if (!sdr_begin_xn(sdr)) goto fail;
+	Object extent = sdr_malloc(sdr, len);
+	if (extent) { sdr_write(sdr, extent, (char *)buf, len); }
+	if (sdr_end_xn(sdr) < 0) goto fail;
+	metrics_observe(MH_SDR_XN, t0);
+	if (extent == 0) {
+		if (tx->spill) goto nospace;
+		putErrmsg("No space for ZCO extent.", NULL);
+		goto fail;
+	}
+
+	t0 = metrics_now();
+	Object zco = ionCreateZco(ZcoSdrSource, extent, 0, len,
+	                          BP_STD_PRIORITY, 0, ZcoOutbound, tx->attendant);
+	metrics_observe(MH_ZCO, t0);
+	if (zco == 0 && tx->spill) {
+		/* Out of ZCO space: give the extent back */
+		if (sdr_begin_xn(sdr)) {
+			sdr_free(sdr, extent);
+			(void)sdr_end_xn(sdr);
+		}
+		goto nospace;
+	}
+	if (zco == 0 || zco == (Object)ERROR) {
+		putErrmsg("Can't create ZCO extent.", NULL);
+		goto fail;
+	}
+
+	Object newBundle;
+	t0 = metrics_now();
+	if (bp_send(tx->sap, (char *)eid, NULL, ttl, BP_STD_PRIORITY,
+	            NoCustodyRequested, 0, 0, NULL, zco, &newBundle) < 1)
+	{
+		putErrmsg("bpbme280 can't send ADU.", NULL);
+		goto fail;
+	}
+	metrics_observe(MH_SEND, t0);
+	metrics_add(MC_BUNDLES, 1);
+	metrics_add(MC_BYTES, (uint64_t)len);
+	return 0;
+
+nospace:
+	metrics_add(MC_NOSPACE, 1);
+	return BPTX_NOSPACE;
+fail:
+	metrics_add(MC_SEND_FAILURES, 1);
+	return -1;
+}
+
+void bptx_replay(bptx_t *tx)
+{
+	const uint8_t *p, *data;
+	size_t len, data_len;
+	char eid[BPTX_EID_MAX + 1];
+	int ttl;
+
+	if (!tx->spill || spill_count(tx->spill) == 0) return;
+	while (spill_peek(tx->spill, &p, &len) == 0) {
+		if (bptx_queue_parse(p, len, eid, &ttl, &data, &data_len) < 0) {
+			metrics_add(MC_SPILL_DROPPED, 1);    /* not an entry: never sendable */
+		} else {
+			/* Out of space or BP failing: the entry stays for the next try */
+			if (bptx_send(tx, eid, ttl, data, (int)data_len) < 0) return;
+			tx->replayed++;
+		}
+		spill_consume(tx->spill);
+	}
+	printf("[i] spill: queue replayed (%llu payload(s) so far)\n", (unsigned long long)tx->replayed);
+	fflush(stdout);
+}
+
+int bptx_deliver(bptx_t *tx, const void *buf, int len)
+{
+	if (!tx->spill) return bptx_send(tx, tx->destEid, tx->ttl, buf, len);
+
+	bptx_replay(tx);
+	if (spill_count(tx->spill) == 0) {
+		int rc = bptx_send(tx, tx->destEid, tx->ttl, buf, len);
+		if (rc != BPTX_NOSPACE) return rc;
+		printf("[?] ION out of ZCO/SDR space: queueing payloads in %s\n", tx->spill_path);
+		fflush(stdout);
+	}
+	if (bptx_queue_append(tx->spill, tx->destEid, tx->ttl, buf, (size_t)len) < 0 || spill_sync(tx->spill) < 0) {
+		putErrmsg("Spill file full or not writable; payload dropped.", tx->spill_path);
+		return -1;
+	}
+	tx->spilled++;
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * bptx.h: One payload -> one bundle, through ION's SDR, ZCO and bp_send(),
+ * with the spill file (spill.h) behind it.
+ *
+ * With a spill file ZCOs are created without the attendant, so a payload
+ * that finds no SDR/ZCO space returns at once and is queued on disk; later
+ * payloads queue behind it to keep the order, and the queue is replayed
+ * (oldest first) whenever ION has room again. Without one, the attendant
+ * blocks until space frees up. Spill and journal entries start with the
+ * destination and TTL of the run that queued them, so a later run with
+ * other arguments still sends every entry where it was meant to go.
+ */
+#ifndef BPTX_H
+#define BPTX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bp.h>                   /* ION BP API (or mockbp/bp.h) */
+
+#include "spill.h"
+
+#define BPTX_NOSPACE -2
+#define BPTX_EID_MAX 255
+
+typedef struct {
+	Sdr           sdr;
+	BpSAP         sap;
+	char         *destEid;
+	int           ttl;
+	ReqAttendant *attendant;
+	spill_t      *spill;         /* NULL: no spilling */
+	const char   *spill_path;
+	uint64_t      spilled;       /* payloads queued on disk */
+	uint64_t      replayed;      /* payloads sent from the spill file */
+} bptx_t;
+
+/* Queue buf on sp tagged with its destination and TTL; as spill_append() */
+int  bptx_queue_append(spill_t *sp, const char *eid, int ttl, const void *buf, size_t len);
+/* Destination (NUL-terminated into eid[BPTX_EID_MAX + 1]), TTL and data
+ * of an entry; -1 if it is not one */
+int  bptx_queue_parse(const uint8_t *p, size_t len, char *eid, int *ttl,
+                      const uint8_t **data, size_t *data_len);
+/* One bundle to eid: 0, BPTX_NOSPACE (nothing sent, nothing leaked), or -1 */
+int  bptx_send(const bptx_t *tx, const char *eid, int ttl, const void *buf, int len);
+/* Spilled payloads, oldest first, until ION runs out of space again or a
+ * send fails; the payload it stopped at stays queued. Entries that cannot
+ * be parsed are dropped (bpbme280_spill_dropped_total). */
+void bptx_replay(bptx_t *tx);
+/* Send to tx->destEid, or queue on disk behind older payloads / when ION
+ * is out of space. 0 if the payload was sent or kept. */
+int  bptx_deliver(bptx_t *tx, const void *buf, int len);
+
+#endif /* BPTX_H */
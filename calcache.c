@@ -0,0 +1,140 @@
+/*
+ * calcache.c: On-disk cache for BME280 calibration data (see calcache.h).
+ *
+ * File layout (native endianness, written and read on the same host):
+ *   calcache_hdr_t | calibration blob (calib_len bytes)
+ * The checksum is FNV-1a over the header (checksum field zeroed) and blob.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "calcache.h"
+
+#define CALCACHE_MAGIC   0x43454d42u  /* "BMEC" */
+#define CALCACHE_VERSION 2
+#define CALCACHE_DEVLEN  64
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t calib_len;
+	uint16_t addr;
+	uint8_t  chip_id;
+	uint8_t  reserved;
+	uint32_t checksum;
+	char     dev[CALCACHE_DEVLEN];
+} calcache_hdr_t;
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static uint32_t calcache_checksum(const calcache_hdr_t *hdr, const void *calib, size_t calib_len)
+{
+	calcache_hdr_t h = *hdr;
+	h.checksum = 0;
+	uint32_t sum = fnv1a(2166136261u, &h, sizeof h);
+	return fnv1a(sum, calib, calib_len);
+}
+
+/* <dir>/<dev with '/' -> '_'>-<addr>.cal, e.g. /var/cache/bpbme280/_dev_i2c-1-76.cal */
+static int calcache_path(char *out, size_t outlen, const char *dir, const char *dev, uint16_t addr)
+{
+	char name[CALCACHE_DEVLEN];
+	size_t i;
+	for (i = 0; dev[i] && i < sizeof(name) - 1; i++) {
+		name[i] = (dev[i] == '/') ? '_' : dev[i];
+	}
+	name[i] = '\0';
+	int n = snprintf(out, outlen, "%s/%s-%02x.cal", dir, name, addr);
+	return (n > 0 && (size_t)n < outlen) ? 0 : -1;
+}
+
+static void calcache_key(calcache_hdr_t *hdr, const char *dev, uint16_t addr, uint8_t chip_id,
+                         size_t calib_len)
+{
+	memset(hdr, 0, sizeof *hdr);
+	hdr->magic = CALCACHE_MAGIC;
+	hdr->version = CALCACHE_VERSION;
+	hdr->calib_len = (uint16_t)calib_len;
+	hdr->addr = addr;
+	hdr->chip_id = chip_id;
+	strncpy(hdr->dev, dev, sizeof(hdr->dev) - 1);
+}
+
+int calcache_load(const char *dir, const char *dev, uint16_t addr, uint8_t chip_id,
+                  void *calib, size_t calib_len)
+{
+	char path[256];
+	if (calcache_path(path, sizeof path, dir, dev, addr) < 0) return -1;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+
+	size_t size = sizeof(calcache_hdr_t) + calib_len;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size != size) {
+		close(fd);
+		return -1;
+	}
+
+	const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -1;
+
+	const calcache_hdr_t *hdr = (const calcache_hdr_t *)map;
+	const uint8_t *blob = map + sizeof(calcache_hdr_t);
+	calcache_hdr_t want;
+	calcache_key(&want, dev, addr, chip_id, calib_len);
+
+	int rc = -1;
+	if (hdr->magic == want.magic && hdr->version == want.version &&
+	    hdr->calib_len == want.calib_len && hdr->addr == want.addr &&
+	    hdr->chip_id == want.chip_id &&
+	    memcmp(hdr->dev, want.dev, sizeof want.dev) == 0 &&
+	    hdr->checksum == calcache_checksum(hdr, blob, calib_len)) {
+		memcpy(calib, blob, calib_len);
+		rc = 0;
+	}
+	munmap((void *)map, size);
+	return rc;
+}
+
+int calcache_store(const char *dir, const char *dev, uint16_t addr, uint8_t chip_id,
+                   const void *calib, size_t calib_len)
+{
+	char path[256], tmp[272];
+	if (calcache_path(path, sizeof path, dir, dev, addr) < 0) return -1;
+	snprintf(tmp, sizeof tmp, "%s.%ld", path, (long)getpid());
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+
+	calcache_hdr_t hdr;
+	calcache_key(&hdr, dev, addr, chip_id, calib_len);
+	hdr.checksum = calcache_checksum(&hdr, calib, calib_len);
+
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) return -1;
+	int ok = write(fd, &hdr, sizeof hdr) == (ssize_t)sizeof hdr &&
+	         write(fd, calib, calib_len) == (ssize_t)calib_len &&
+	         fsync(fd) == 0;
+	if (close(fd) < 0) ok = 0;
+	if (!ok || rename(tmp, path) < 0) {
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
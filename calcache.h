@@ -0,0 +1,25 @@
+/*
+ * calcache.h: On-disk cache for BME280 calibration (NVM trimming) data.
+ *
+ * One small file per sensor, keyed by I2C device path, slave address and
+ * chip id. The file is memory-mapped read-only and holds the calibration
+ * struct in native layout, so loading is a header check plus a memcpy.
+ */
+#ifndef CALCACHE_H
+#define CALCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CALCACHE_DEFAULT_DIR "/var/cache/bpbme280"
+
+/* Copy the cached calibration blob into calib (calib_len bytes).
+ * Returns 0 on a valid hit, -1 on miss, mismatch or corruption. */
+int calcache_load(const char *dir, const char *dev, uint16_t addr, uint8_t chip_id,
+                  void *calib, size_t calib_len);
+
+/* Atomically (write + rename) store a calibration blob. Returns 0 or -1. */
+int calcache_store(const char *dir, const char *dev, uint16_t addr, uint8_t chip_id,
+                   const void *calib, size_t calib_len);
+
+#endif /* CALCACHE_H */
@@ -0,0 +1,173 @@
+/*
+ * cbor.c: Minimal bounded CBOR writer/reader (see cbor.h).
+ */
+
+#include <string.h>
+
+#include "cbor.h"
+
+/* ---------------- Writer ---------------- */
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t len)
+{
+	w->p = buf;
+	w->end = buf + len;
+	w->err = 0;
+}
+
+void cbor_put_byte(cbor_writer_t *w, uint8_t b)
+{
+	if (w->err || w->p >= w->end) { w->err = 1; return; }
+	*w->p++ = b;
+}
+
+/* Shortest encoding of (major, argument) */
+void cbor_put_head(cbor_writer_t *w, int major, uint64_t val)
+{
+	uint8_t mt = (uint8_t)(major << 5);
+	int n;
+	if (val < 24)                { cbor_put_byte(w, mt | (uint8_t)val); return; }
+	else if (val <= 0xff)        { cbor_put_byte(w, mt | 24); n = 1; }
+	else if (val <= 0xffff)      { cbor_put_byte(w, mt | 25); n = 2; }
+	else if (val <= 0xffffffffu) { cbor_put_byte(w, mt | 26); n = 4; }
+	else                         { cbor_put_byte(w, mt | 27); n = 8; }
+	while (n--) cbor_put_byte(w, (uint8_t)(val >> (8 * n)));
+}
+
+void cbor_put_int(cbor_writer_t *w, int64_t val)
+{
+	if (val >= 0) cbor_put_head(w, CBOR_UINT, (uint64_t)val);
+	else          cbor_put_head(w, CBOR_NEGINT, (uint64_t)(-1 - val));
+}
+
+static void cbor_put_string(cbor_writer_t *w, int major, const void *s, size_t len)
+{
+	cbor_put_head(w, major, len);
+	if (w->err || (size_t)(w->end - w->p) < len) { w->err = 1; return; }
+	memcpy(w->p, s, len);
+	w->p += len;
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *s)
+{
+	cbor_put_string(w, CBOR_TEXT, s, strlen(s));
+}
+
+void cbor_put_bytes(cbor_writer_t *w, const uint8_t *b, size_t len)
+{
+	cbor_put_string(w, CBOR_BYTES, b, len);
+}
+
+int cbor_writer_len(const cbor_writer_t *w, const uint8_t *buf)
+{
+	return w->err ? -1 : (int)(w->p - buf);
+}
+
+/* ---------------- Reader ---------------- */
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t len)
+{
+	r->p = buf;
+	r->end = buf + len;
+	r->err = 0;
+}
+
+int cbor_at_end(const cbor_reader_t *r)
+{
+	return r->err || r->p >= r->end;
+}
+
+int cbor_get_head(cbor_reader_t *r, uint64_t *val, int *indef)
+{
+	*val = 0;
+	if (indef) *indef = 0;
+	if (r->err || r->p >= r->end) { r->err = 1; return -1; }
+
+	uint8_t ib = *r->p++;
+	int major = ib >> 5;
+	uint8_t ai = ib & 0x1f;
+	int n;
+
+	if (ai < 24) { *val = ai; return major; }
+	switch (ai) {
+	case 24: n = 1; break;
+	case 25: n = 2; break;
+	case 26: n = 4; break;
+	case 27: n = 8; break;
+	case 31:
+		if (major == CBOR_ARRAY && indef) { *indef = 1; return major; }
+		if (major == CBOR_SIMPLE) { *val = 31; return major; }
+		/* fall through */
+	default:
+		r->err = 1;
+		return -1;
+	}
+	if (r->end - r->p < n) { r->err = 1; return -1; }
+	while (n--) *val = (*val << 8) | *r->p++;
+	return major;
+}
+
+int cbor_get_int(cbor_reader_t *r, int64_t *val)
+{
+	uint64_t v;
+	int major = cbor_get_head(r, &v, NULL);
+	if (major == CBOR_UINT && v <= INT64_MAX)   { *val = (int64_t)v; return 0; }
+	if (major == CBOR_NEGINT && v <= INT64_MAX) { *val = -1 - (int64_t)v; return 0; }
+	r->err = 1;
+	return -1;
+}
+
+static const uint8_t *cbor_get_string(cbor_reader_t *r, int major, size_t *len)
+{
+	uint64_t v;
+	if (cbor_get_head(r, &v, NULL) != major || (uint64_t)(r->end - r->p) < v) {
+		r->err = 1;
+		return NULL;
+	}
+	const uint8_t *s = r->p;
+	*len = (size_t)v;
+	r->p += v;
+	return s;
+}
+
+int cbor_get_text(cbor_reader_t *r, const char **s, size_t *len)
+{
+	*s = (const char *)cbor_get_string(r, CBOR_TEXT, len);
+	return *s ? 0 : -1;
+}
+
+int cbor_get_bytes(cbor_reader_t *r, const uint8_t **b, size_t *len)
+{
+	*b = cbor_get_string(r, CBOR_BYTES, len);
+	return *b ? 0 : -1;
+}
+
+void cbor_skip(cbor_reader_t *r)
+{
+	uint64_t v;
+	int indef;
+	switch (cbor_get_head(r, &v, &indef)) {
+	case CBOR_UINT:
+	case CBOR_NEGINT:
+	case CBOR_SIMPLE:
+		break;
+	case CBOR_BYTES:
+	case CBOR_TEXT:
+		if ((uint64_t)(r->end - r->p) < v) { r->err = 1; break; }
+		r->p += v;
+		break;
+	case CBOR_ARRAY:
+		if (indef) {
+			while (!r->err && r->p < r->end && *r->p != CBOR_BREAK) cbor_skip(r);
+			if (r->p < r->end) r->p++;
+			else r->err = 1;
+		} else {
+			while (!r->err && v--) cbor_skip(r);
+		}
+		break;
+	case CBOR_MAP:
+		while (!r->err && v--) { cbor_skip(r); cbor_skip(r); }
+		break;
+	default:
+		r->err = 1;
+		break;
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * cbor.h: Minimal bounded CBOR (RFC 8949) writer/reader for bpbme280 payloads.
+ *
+ * Only what the record format needs: unsigned/negative integers, byte and
+ * text strings, maps and arrays (definite, plus indefinite-length arrays for
+ * batches). Writers and readers carry an error flag instead of returning
+ * status from every call; check it once at the end.
+ */
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Major types */
+#define CBOR_UINT   0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES  2
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+#define CBOR_SIMPLE 7
+
+#define CBOR_INDEF_ARRAY 0x9f
+#define CBOR_BREAK       0xff
+
+typedef struct {
+	uint8_t *p;
+	uint8_t *end;
+	int      err;
+} cbor_writer_t;
+
+typedef struct {
+	const uint8_t *p;
+	const uint8_t *end;
+	int            err;
+} cbor_reader_t;
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t len);
+void cbor_put_head(cbor_writer_t *w, int major, uint64_t val);
+void cbor_put_int(cbor_writer_t *w, int64_t val);
+void cbor_put_text(cbor_writer_t *w, const char *s);
+void cbor_put_bytes(cbor_writer_t *w, const uint8_t *b, size_t len);
+void cbor_put_byte(cbor_writer_t *w, uint8_t b);
+/* Bytes written so far, or -1 if the buffer overflowed */
+int  cbor_writer_len(const cbor_writer_t *w, const uint8_t *buf);
+
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t len);
+/* Next item head. Returns the major type; *val gets the argument (length
+ * for text/array/map). An indefinite-length array yields CBOR_ARRAY with
+ * *indef set; a break byte yields CBOR_SIMPLE with *val == 31. */
+int  cbor_get_head(cbor_reader_t *r, uint64_t *val, int *indef);
+/* Signed integer item (major 0 or 1) */
+int  cbor_get_int(cbor_reader_t *r, int64_t *val);
+/* Text string: points *s into the buffer (not NUL-terminated) */
+int  cbor_get_text(cbor_reader_t *r, const char **s, size_t *len);
+/* Byte string: points *b into the buffer */
+int  cbor_get_bytes(cbor_reader_t *r, const uint8_t **b, size_t *len);
+/* Skip one complete item of any supported type */
+void cbor_skip(cbor_reader_t *r);
+int  cbor_at_end(const cbor_reader_t *r);
+
+#endif /* CBOR_H */
@@ -0,0 +1,83 @@
+/*
+ * cpustat.c: pread()-based CPU stats (see cpustat.h).
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cpustat.h"
+
+void cpustat_open_paths(cpustat_t *cs, const char *temp_path, const char *load_path)
+{
+	cs->temp_fd = open(temp_path, O_RDONLY | O_CLOEXEC);
+	cs->load_fd = open(load_path, O_RDONLY | O_CLOEXEC);
+}
+
+void cpustat_open(cpustat_t *cs)
+{
+	cpustat_open_paths(cs, CPUSTAT_TEMP_PATH, CPUSTAT_LOAD_PATH);
+}
+
+void cpustat_close(cpustat_t *cs)
+{
+	if (cs->temp_fd >= 0) close(cs->temp_fd);
+	if (cs->load_fd >= 0) close(cs->load_fd);
+	cs->temp_fd = cs->load_fd = -1;
+}
+
+/* Whole file from offset 0, NUL-terminated; length or -1 */
+static int read_file(int fd, char *buf, size_t len)
+{
+	if (fd < 0) return -1;
+	ssize_t n = pread(fd, buf, len - 1, 0);
+	if (n <= 0) return -1;
+	buf[n] = '\0';
+	return (int)n;
+}
+
+static int is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/* sysfs temp: optional '-', decimal m°C, e.g. "51375\n" */
+int cpustat_temp_mC(const cpustat_t *cs, int32_t *mC)
+{
+	char buf[32];
+	if (read_file(cs->temp_fd, buf, sizeof buf) < 0) return -1;
+
+	const char *p = buf;
+	int neg = (*p == '-');
+	if (neg) p++;
+	if (!is_digit(*p)) return -1;
+	int64_t v = 0;
+	while (is_digit(*p) && v < INT32_MAX) v = v * 10 + (*p++ - '0');
+	*mC = (int32_t)(neg ? -v : v);
+	return 0;
+}
+
+/* First field of /proc/loadavg, e.g. "0.49 0.31 0.27 1/123 4567" */
+int cpustat_load_1min(const cpustat_t *cs, int32_t *load)
+{
+	char buf[128];
+	if (read_file(cs->load_fd, buf, sizeof buf) < 0) return -1;
+
+	const char *p = buf;
+	if (!is_digit(*p)) return -1;
+	int32_t ip = 0;
+	while (is_digit(*p) && ip < 1000000) ip = ip * 10 + (*p++ - '0');
+
+	/* Hundredths, rounded half up on the third decimal */
+	int32_t frac = 0;
+	if (*p == '.') {
+		p++;
+		for (int scale = 10; scale >= 1; scale /= 10) {
+			if (!is_digit(*p)) break;
+			frac += (*p++ - '0') * scale;
+		}
+		if (is_digit(*p) && *p >= '5') frac++;
+	}
+	*load = ip * 100 + frac;
+	return 0;
+}
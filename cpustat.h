@@ -0,0 +1,31 @@
+/*
+ * cpustat.h: CPU temperature and load average for long-running samplers.
+ *
+ * The sysfs/procfs files are opened once and re-read with pread() at
+ * offset 0 into a stack buffer, then parsed with a small integer scanner:
+ * no stdio, no allocation, one syscall per value.
+ */
+#ifndef CPUSTAT_H
+#define CPUSTAT_H
+
+#include <stdint.h>
+
+#define CPUSTAT_TEMP_PATH "/sys/class/thermal/thermal_zone0/temp"
+#define CPUSTAT_LOAD_PATH "/proc/loadavg"
+
+typedef struct {
+	int temp_fd;                 /* -1 if unavailable */
+	int load_fd;
+} cpustat_t;
+
+/* Open both files; a missing one just makes its reads fail */
+void cpustat_open(cpustat_t *cs);
+void cpustat_open_paths(cpustat_t *cs, const char *temp_path, const char *load_path);
+void cpustat_close(cpustat_t *cs);
+
+/* CPU temperature in m°C; 0 or -1 */
+int cpustat_temp_mC(const cpustat_t *cs, int32_t *mC);
+/* 1-minute load average in hundredths, rounded; 0 or -1 */
+int cpustat_load_1min(const cpustat_t *cs, int32_t *load);
+
+#endif /* CPUSTAT_H */
@@ -0,0 +1,203 @@
+/*
+ * deadband.c: Change-triggered reporting (see deadband.h).
+ *
+ * State file layout (native endianness, written and read on the same host):
+ *   deadband_hdr_t | deadband_last_t[SENSORS_MAX + 1]
+ * The checksum is FNV-1a over the header (checksum field zeroed) and the
+ * entries, as in the calibration cache; the key is FNV-1a of the
+ * destination EID.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "deadband.h"
+
+#define DEADBAND_MAGIC   0x4c454d42u  /* "BMEL" */
+#define DEADBAND_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;              /* entries */
+	uint32_t checksum;
+	uint32_t key;                /* destination the state was kept for */
+} deadband_hdr_t;
+
+/* Wire units per field unit, by REC_KEY_TEMP..REC_KEY_LOAD */
+static const int scale[REC_KEY_LOC] = {
+	0, REC_SCALE_TEMP, REC_SCALE_PRESS, REC_SCALE_HUMID, REC_SCALE_CPU_TEMP, REC_SCALE_LOAD,
+};
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static uint32_t deadband_checksum(const deadband_hdr_t *hdr, const deadband_last_t *last)
+{
+	deadband_hdr_t h = *hdr;
+	h.checksum = 0;
+	uint32_t sum = fnv1a(2166136261u, &h, sizeof h);
+	return fnv1a(sum, last, sizeof(deadband_last_t) * hdr->count);
+}
+
+int deadband_parse(deadband_t *db, const char *spec)
+{
+	const char *p = spec;
+
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) db->thr[k] = -1;
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC && *p != '\0'; k++) {
+		if (*p != ',') {
+			char *end;
+			double x = strtod(p, &end);
+			if (end == p || x < 0) return -1;
+			db->thr[k] = llround(x * scale[k]);
+			p = end;
+		}
+		if (*p == ',') p++;
+		else if (*p != '\0') return -1;
+	}
+	if (*p != '\0') return -1;
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) {
+		if (db->thr[k] >= 0) return 0;
+	}
+	return -1;                          /* nothing to watch */
+}
+
+/* The directory of path, one level, like the calibration cache */
+static void deadband_mkdir(const char *path)
+{
+	char dir[272];
+	const char *slash = strrchr(path, '/');
+	if (!slash || slash == path || (size_t)(slash - path) >= sizeof dir) return;
+	memcpy(dir, path, slash - path);
+	dir[slash - path] = '\0';
+	(void)mkdir(dir, 0755);
+}
+
+int deadband_open(deadband_t *db, const char *path, const char *dest)
+{
+	deadband_hdr_t hdr;
+	deadband_last_t last[SENSORS_MAX + 1];
+	char lock[272];
+
+	memset(db->last, 0, sizeof db->last);
+	memset(db->pend, 0, sizeof db->pend);
+	db->path = NULL;
+	db->key = fnv1a(2166136261u, dest, strlen(dest));
+	db->lock_fd = -1;
+	db->dirty = 0;
+	db->synced = time(NULL);
+	if (!path) return 0;
+
+	/* The state file is replaced by rename(), so the lock is on a file
+	 * of its own */
+	deadband_mkdir(path);
+	snprintf(lock, sizeof lock, "%s.lock", path);
+	db->lock_fd = open(lock, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (db->lock_fd >= 0 && flock(db->lock_fd, LOCK_EX | LOCK_NB) < 0) {
+		close(db->lock_fd);
+		db->lock_fd = -1;
+		return -1;
+	}
+	db->path = path;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return 0;
+	int ok = read(fd, &hdr, sizeof hdr) == (ssize_t)sizeof hdr &&
+	         hdr.magic == DEADBAND_MAGIC && hdr.version == DEADBAND_VERSION &&
+	         hdr.count == SENSORS_MAX + 1 && hdr.key == db->key &&
+	         read(fd, last, sizeof last) == (ssize_t)sizeof last &&
+	         hdr.checksum == deadband_checksum(&hdr, last);
+	close(fd);
+	if (ok) memcpy(db->last, last, sizeof last);
+	memcpy(db->pend, db->last, sizeof db->pend);
+	return 0;
+}
+
+int deadband_check(deadband_t *db, const sample_t *s, int replay)
+{
+	deadband_last_t *l = &db->pend[s->sid];
+	int64_t v[REC_KEY_LOC];
+	/* Older than the staged reading: live, the clock went back; replayed,
+	 * newer readings simply went out first, so only the thresholds count */
+	int older = (s->ts < l->ts);
+	int send = (l->ts == 0 || (older && !replay) ||
+	            (!older && db->heartbeat > 0 && s->ts - l->ts >= db->heartbeat));
+
+	rec_to_wire(s, v);
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC && !send; k++) {
+		if (db->thr[k] >= 0 && llabs(v[k] - l->v[k]) > db->thr[k]) send = 1;
+	}
+	if (!send) db->suppressed++;
+	return send;
+}
+
+void deadband_stage(deadband_t *db, const sample_t *s, int replay)
+{
+	deadband_last_t *l = &db->pend[s->sid];
+	if (replay && s->ts < l->ts) return;
+	rec_to_wire(s, l->v);
+	l->ts = s->ts;
+}
+
+void deadband_commit(deadband_t *db)
+{
+	if (memcmp(db->last, db->pend, sizeof db->last) == 0) return;
+	memcpy(db->last, db->pend, sizeof db->last);
+	db->dirty = 1;
+}
+
+void deadband_rollback(deadband_t *db)
+{
+	memcpy(db->pend, db->last, sizeof db->pend);
+}
+
+int deadband_sync(deadband_t *db)
+{
+	char tmp[272];
+	if (!db->path || !db->dirty) return 0;
+	snprintf(tmp, sizeof tmp, "%s.%ld", db->path, (long)getpid());
+	deadband_mkdir(db->path);
+
+	deadband_hdr_t hdr = {
+		.magic = DEADBAND_MAGIC, .version = DEADBAND_VERSION, .count = SENSORS_MAX + 1,
+		.key = db->key,
+	};
+	hdr.checksum = deadband_checksum(&hdr, db->last);
+
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) return -1;
+	int ok = write(fd, &hdr, sizeof hdr) == (ssize_t)sizeof hdr &&
+	         write(fd, db->last, sizeof db->last) == (ssize_t)sizeof db->last &&
+	         fsync(fd) == 0;
+	if (close(fd) < 0) ok = 0;
+	if (!ok || rename(tmp, db->path) < 0) {
+		unlink(tmp);
+		return -1;
+	}
+	db->dirty = 0;
+	db->synced = time(NULL);
+	return 0;
+}
+
+void deadband_close(deadband_t *db)
+{
+	(void)deadband_sync(db);
+	if (db->lock_fd >= 0) close(db->lock_fd);
+	db->lock_fd = -1;
+}
@@ -0,0 +1,69 @@
+/*
+ * deadband.h: Change-triggered reporting (send on change, or heartbeat).
+ *
+ * A reading is sent only if one of the watched fields moved by more than
+ * its threshold from the value last sent for that sensor, or the heartbeat
+ * expired. Fields are compared at wire precision (record.h), so what is
+ * suppressed is exactly what the receiver would not have seen change.
+ * The last-sent values are kept in a small file so the one-shot/timer
+ * deployment, where every run is a new process, behaves the same. The
+ * file records the destination it was kept for (a run sending elsewhere
+ * starts empty) and is locked through <file>.lock while a run uses it.
+ */
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <stdint.h>
+
+#include "record.h"
+#include "sensors.h"
+
+#define DEADBAND_DEFAULT_FILE  "/var/cache/bpbme280/lastsent"
+#define DEADBAND_HEARTBEAT_SEC 3600
+#define DEADBAND_SYNC_SEC      60     /* state file writes while running, at most */
+
+typedef struct {
+	int64_t ts;                  /* UNIX seconds of the reading; 0 = none sent */
+	int64_t v[REC_KEY_LOC];      /* wire values, by REC_KEY_TEMP..REC_KEY_LOAD */
+} deadband_last_t;
+
+typedef struct {
+	int64_t          thr[REC_KEY_LOC];    /* wire units; -1 = not watched */
+	int              heartbeat;           /* seconds; 0 = never */
+	const char      *path;                /* state file; NULL = memory only */
+	uint32_t         key;                 /* hash of the destination */
+	int              lock_fd;             /* <path>.lock, held while open */
+	deadband_last_t  last[SENSORS_MAX + 1];   /* by sid; sent */
+	deadband_last_t  pend[SENSORS_MAX + 1];   /* by sid; batched, or sent */
+	int              dirty;               /* last[] changed since the file was written */
+	int64_t          synced;              /* UNIX seconds of the last write (or open) */
+	uint64_t         suppressed;
+} deadband_t;
+
+/* Thresholds "<temp>,<press>,<humid>[,<cpu_temp>,<load>]" in °C, hPa, %RH,
+ * °C and load; empty or omitted fields are not watched. 0 or -1. */
+int  deadband_parse(deadband_t *db, const char *spec);
+/* Lock and read the last-sent state for destination dest from path (a
+ * missing or stale file, or one kept for another destination, is an
+ * empty state) and keep path for deadband_sync(); path may be NULL.
+ * 0, or -1 if another process holds the file (the state is then kept in
+ * memory only). */
+int  deadband_open(deadband_t *db, const char *path, const char *dest);
+/* 1 if s should be sent, 0 if it is within the dead band of the last
+ * reading staged for its sensor. A live reading older than that one means
+ * the clock went back and is sent; a replayed (journal) one is just late
+ * and is held to the thresholds. */
+int  deadband_check(deadband_t *db, const sample_t *s, int replay);
+/* s is on its way (batched or delivered): the reading the next one of its
+ * sensor is compared with, unless it is replayed and older than that */
+void deadband_stage(deadband_t *db, const sample_t *s, int replay);
+/* What was staged has been sent: it becomes the last-sent state */
+void deadband_commit(deadband_t *db);
+/* What was staged was not sent: compare with the last-sent state again */
+void deadband_rollback(deadband_t *db);
+/* Atomically (write + rename) store the state if it changed. 0 or -1. */
+int  deadband_sync(deadband_t *db);
+/* Sync and release the file */
+void deadband_close(deadband_t *db);
+
+#endif /* DEADBAND_H */
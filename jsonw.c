@@ -0,0 +1,93 @@
+/*
+ * jsonw.c: Allocation-free JSON text writer (see jsonw.h).
+ */
+
+#include <string.h>
+
+#include "jsonw.h"
+
+void jw_init(jsonw_t *w, char *buf, size_t len)
+{
+	w->p = buf;
+	w->end = buf + (len ? len - 1 : 0);
+	w->err = (len == 0);
+}
+
+void jw_raw(jsonw_t *w, const char *s, size_t len)
+{
+	if (w->err || (size_t)(w->end - w->p) < len) { w->err = 1; return; }
+	memcpy(w->p, s, len);
+	w->p += len;
+}
+
+void jw_char(jsonw_t *w, char c)
+{
+	if (w->err || w->p >= w->end) { w->err = 1; return; }
+	*w->p++ = c;
+}
+
+/* Digits of u, at least min_digits wide (zero padded) */
+static void jw_digits(jsonw_t *w, uint64_t u, unsigned min_digits)
+{
+	char tmp[20];
+	unsigned n = 0;
+	do {
+		tmp[n++] = (char)('0' + u % 10);
+		u /= 10;
+	} while (u);
+	while (n < min_digits && n < sizeof tmp) tmp[n++] = '0';
+
+	if (w->err || (size_t)(w->end - w->p) < n) { w->err = 1; return; }
+	while (n) *w->p++ = tmp[--n];
+}
+
+static uint64_t jw_abs(jsonw_t *w, int64_t v)
+{
+	if (v >= 0) return (uint64_t)v;
+	jw_char(w, '-');
+	return (uint64_t)(-(v + 1)) + 1;
+}
+
+void jw_int(jsonw_t *w, int64_t v)
+{
+	jw_digits(w, jw_abs(w, v), 1);
+}
+
+void jw_fixed(jsonw_t *w, int64_t v, unsigned decimals)
+{
+	static const uint64_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+	if (decimals >= sizeof pow10 / sizeof pow10[0]) { w->err = 1; return; }
+	uint64_t u = jw_abs(w, v);
+	jw_digits(w, u / pow10[decimals], 1);
+	if (decimals) {
+		jw_char(w, '.');
+		jw_digits(w, u % pow10[decimals], decimals);
+	}
+}
+
+void jw_str(jsonw_t *w, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	jw_char(w, '"');
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') {
+			jw_char(w, '\\');
+			jw_char(w, (char)c);
+		} else if (c < 0x20) {
+			JW_LIT(w, "\\u00");
+			jw_char(w, hex[c >> 4]);
+			jw_char(w, hex[c & 0x0f]);
+		} else {
+			jw_char(w, (char)c);
+		}
+	}
+	jw_char(w, '"');
+}
+
+int jw_finish(jsonw_t *w, const char *buf)
+{
+	if (w->err) return -1;
+	*w->p = '\0';
+	return (int)(w->p - buf);
+}
@@ -0,0 +1,41 @@
+/*
+ * jsonw.h: Allocation-free JSON text writer for fixed-point records.
+ *
+ * Writes straight into a caller buffer through a bounds-checked cursor.
+ * Numbers are emitted digit by digit from integers: no snprintf, no
+ * varargs, no locale, no floating point. Overflow sets a sticky error
+ * flag; check it once with jw_finish().
+ */
+#ifndef JSONW_H
+#define JSONW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	char *p;
+	char *end;                   /* one past the last usable byte (NUL kept free) */
+	int   err;
+} jsonw_t;
+
+void jw_init(jsonw_t *w, char *buf, size_t len);
+void jw_raw(jsonw_t *w, const char *s, size_t len);
+void jw_char(jsonw_t *w, char c);
+void jw_int(jsonw_t *w, int64_t v);
+/* v is the value scaled by 10^decimals, e.g. jw_fixed(w, -5, 1) -> "-0.5" */
+void jw_fixed(jsonw_t *w, int64_t v, unsigned decimals);
+/* Quoted string with JSON escaping */
+void jw_str(jsonw_t *w, const char *s);
+/* NUL-terminate; returns the text length, or -1 on overflow */
+int  jw_finish(jsonw_t *w, const char *buf);
+
+/* Append a string literal without strlen() */
+#define JW_LIT(w, lit) jw_raw((w), (lit), sizeof(lit) - 1)
+
+/* num/den rounded half away from zero (den > 0) */
+static inline int64_t jw_round_div(int64_t num, int64_t den)
+{
+	return (num >= 0) ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+#endif /* JSONW_H */
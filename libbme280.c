@@ -0,0 +1,432 @@
+/*
+ * libbme280.c: BME280 access and integer compensation (see libbme280.h).
+ *
+ * Build:
+ *   gcc -O2 -Wall -Wextra -std=c11 -c libbme280.c && ar rcs libbme280.a libbme280.o
+ */
+
+#define _GNU_SOURCE
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/spi/spidev.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "bme280_comp.h"
+#include "libbme280.h"
+
+/* ---------------- I2C transport ---------------- */
+/* ctx is the descriptor itself */
+#define CTX_FD(ctx) ((int)(intptr_t)(ctx))
+
+static int i2c_write_reg(void *ctx, uint16_t addr, uint8_t reg, uint8_t val)
+{
+	uint8_t buf[2] = {reg, val};
+	struct i2c_msg msg = { .addr = addr, .flags = 0, .len = 2, .buf = buf };
+	struct i2c_rdwr_ioctl_data xfer = { .msgs = &msg, .nmsgs = 1 };
+	return (ioctl(CTX_FD(ctx), I2C_RDWR, &xfer) == 1) ? 0 : -1;
+}
+
+/* Register address write, then read with a repeated start: one syscall,
+ * no STOP between the two. */
+static int i2c_read_regs(void *ctx, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len)
+{
+	struct i2c_msg msgs[2] = {
+		{ .addr = addr, .flags = 0,        .len = 1,             .buf = &start_reg },
+		{ .addr = addr, .flags = I2C_M_RD, .len = (uint16_t)len, .buf = buf },
+	};
+	struct i2c_rdwr_ioctl_data xfer = { .msgs = msgs, .nmsgs = 2 };
+	return (ioctl(CTX_FD(ctx), I2C_RDWR, &xfer) == 2) ? 0 : -1;
+}
+
+static const bme280_transport_t i2c_transport = { i2c_read_regs, i2c_write_reg, NULL };
+
+/* ---------------- SPI transport ---------------- */
+#define SPI_READ      0x80           /* RW bit of the address byte */
+#define SPI_XFER_MAX  64             /* longest burst: calibration block, 26 bytes */
+
+int bme280_spi_setup(int fd, uint32_t hz)
+{
+	uint8_t mode = SPI_MODE_0, bits = 8;
+	if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0) return -1;
+	if (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) return -1;
+	return (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &hz) < 0) ? -1 : 0;
+}
+
+static int spi_write_reg(void *ctx, uint16_t addr, uint8_t reg, uint8_t val)
+{
+	(void)addr;
+	uint8_t tx[2] = { (uint8_t)(reg & ~SPI_READ), val };
+	struct spi_ioc_transfer t = { .tx_buf = (uintptr_t)tx, .len = 2 };
+	return (ioctl(CTX_FD(ctx), SPI_IOC_MESSAGE(1), &t) < 0) ? -1 : 0;
+}
+
+/* Address byte out, len bytes in, chip select held: one transfer per
+ * block, CS released between blocks */
+static int spi_read_blocks(int fd, const uint8_t *regs, uint8_t *const *bufs, const size_t *lens, int n)
+{
+	uint8_t tx[2][SPI_XFER_MAX + 1], rx[2][SPI_XFER_MAX + 1];
+	struct spi_ioc_transfer t[2];
+
+	if (n > 2) return -1;
+	memset(t, 0, sizeof t);
+	for (int i = 0; i < n; i++) {
+		if (lens[i] > SPI_XFER_MAX) return -1;
+		memset(tx[i], 0, lens[i] + 1);
+		tx[i][0] = regs[i] | SPI_READ;
+		t[i].tx_buf = (uintptr_t)tx[i];
+		t[i].rx_buf = (uintptr_t)rx[i];
+		t[i].len = (uint32_t)lens[i] + 1;
+		t[i].cs_change = (i + 1 < n);
+	}
+	if (ioctl(fd, SPI_IOC_MESSAGE(n), t) < 0) return -1;
+	for (int i = 0; i < n; i++) memcpy(bufs[i], rx[i] + 1, lens[i]);
+	return 0;
+}
+
+static int spi_read_regs(void *ctx, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len)
+{
+	(void)addr;
+	return spi_read_blocks(CTX_FD(ctx), &start_reg, &buf, &len, 1);
+}
+
+static const bme280_transport_t spi_transport = { spi_read_regs, spi_write_reg, NULL };
+
+/* ---------------- Attached transports ---------------- */
+/* Attach/close happen during setup and teardown only, before and after
+ * the sampling threads run, so lookups need no lock. */
+#define ATTACHED_MAX 16
+
+static struct {
+	int                       fd;
+	const bme280_transport_t *t;
+	void                     *ctx;
+} attached[ATTACHED_MAX];
+static int nattached;
+
+static const bme280_transport_t *transport_of(int fd, uint16_t addr, void **ctx)
+{
+	for (int i = 0; i < nattached; i++) {
+		if (attached[i].fd == fd) {
+			*ctx = attached[i].ctx;
+			return attached[i].t;
+		}
+	}
+	*ctx = (void *)(intptr_t)fd;
+	return (addr == BME280_ADDR_SPI) ? &spi_transport : &i2c_transport;
+}
+
+int bme280_transport_attach(int fd, const bme280_transport_t *t, void *ctx)
+{
+	if (nattached >= ATTACHED_MAX) return -1;
+	attached[nattached].fd = fd;
+	attached[nattached].t = t;
+	attached[nattached].ctx = ctx;
+	nattached++;
+	return 0;
+}
+
+int bme280_close(int fd)
+{
+	for (int i = 0; i < nattached; i++) {
+		if (attached[i].fd != fd) continue;
+		if (attached[i].t->close) attached[i].t->close(attached[i].ctx);
+		attached[i] = attached[--nattached];
+		break;
+	}
+	return close(fd);
+}
+
+/* ---------------- Register access ---------------- */
+/* Relaxed: bus threads only add, readers want a rough snapshot */
+static _Atomic uint64_t bus_transactions, bus_errors;
+
+static int bus_counted(int rc)
+{
+	atomic_fetch_add_explicit(&bus_transactions, 1, memory_order_relaxed);
+	if (rc < 0) atomic_fetch_add_explicit(&bus_errors, 1, memory_order_relaxed);
+	return rc;
+}
+
+void bme280_bus_stats(bme280_bus_stats_t *st)
+{
+	st->transactions = atomic_load_explicit(&bus_transactions, memory_order_relaxed);
+	st->errors = atomic_load_explicit(&bus_errors, memory_order_relaxed);
+}
+
+int bme280_write_reg(int fd, uint16_t addr, uint8_t reg, uint8_t val)
+{
+	void *ctx;
+	return bus_counted(transport_of(fd, addr, &ctx)->write_reg(ctx, addr, reg, val));
+}
+
+int bme280_read_regs(int fd, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len)
+{
+	void *ctx;
+	return bus_counted(transport_of(fd, addr, &ctx)->read_regs(ctx, addr, start_reg, buf, len));
+}
+
+int bme280_read_reg(int fd, uint16_t addr, uint8_t reg, uint8_t *val)
+{
+	return bme280_read_regs(fd, addr, reg, val, 1);
+}
+
+/* ---------------- Setup ---------------- */
+#define U16_LE(p) ((uint16_t)((p)[0] | ((uint16_t)(p)[1] << 8)))
+#define S16_LE(p) ((int16_t)U16_LE(p))
+
+void bme280_parse_calib(const uint8_t *b1, const uint8_t *b2, bme280_calib_t *c)
+{
+	c->dig_T1 = U16_LE(&b1[0]);  c->dig_T2 = S16_LE(&b1[2]);  c->dig_T3 = S16_LE(&b1[4]);
+	c->dig_P1 = U16_LE(&b1[6]);  c->dig_P2 = S16_LE(&b1[8]);  c->dig_P3 = S16_LE(&b1[10]);
+	c->dig_P4 = S16_LE(&b1[12]); c->dig_P5 = S16_LE(&b1[14]); c->dig_P6 = S16_LE(&b1[16]);
+	c->dig_P7 = S16_LE(&b1[18]); c->dig_P8 = S16_LE(&b1[20]); c->dig_P9 = S16_LE(&b1[22]);
+	c->dig_H1 = b1[25];                      /* 0xA1; 0xA0 is reserved */
+
+	c->dig_H2 = S16_LE(&b2[0]);
+	c->dig_H3 = b2[2];
+	/* H4 = E4[7:0] << 4 | E5[3:0], H5 = E6[7:0] << 4 | E5[7:4]; the MSB
+	 * bytes are signed, so sign-extend them before shifting */
+	c->dig_H4 = (int16_t)((int16_t)(int8_t)b2[3] * 16 | (b2[4] & 0x0F));
+	c->dig_H5 = (int16_t)((int16_t)(int8_t)b2[5] * 16 | (b2[4] >> 4));
+	c->dig_H6 = (int8_t)b2[6];
+	c->t_fine = 0;
+}
+
+void bme280_pack_calib(const bme280_calib_t *c, uint8_t *raw)
+{
+	uint8_t *b1 = raw, *b2 = raw + BME280_CALIB00_LEN;
+	const uint16_t w[12] = {
+		c->dig_T1, (uint16_t)c->dig_T2, (uint16_t)c->dig_T3,
+		c->dig_P1, (uint16_t)c->dig_P2, (uint16_t)c->dig_P3, (uint16_t)c->dig_P4,
+		(uint16_t)c->dig_P5, (uint16_t)c->dig_P6, (uint16_t)c->dig_P7, (uint16_t)c->dig_P8,
+		(uint16_t)c->dig_P9,
+	};
+	for (int i = 0; i < 12; i++) {
+		b1[2 * i] = (uint8_t)w[i];
+		b1[2 * i + 1] = (uint8_t)(w[i] >> 8);
+	}
+	b1[24] = 0;
+	b1[25] = c->dig_H1;
+
+	b2[0] = (uint8_t)c->dig_H2;
+	b2[1] = (uint8_t)((uint16_t)c->dig_H2 >> 8);
+	b2[2] = c->dig_H3;
+	b2[3] = (uint8_t)(c->dig_H4 >> 4);
+	b2[4] = (uint8_t)((c->dig_H4 & 0x0F) | ((c->dig_H5 & 0x0F) << 4));
+	b2[5] = (uint8_t)(c->dig_H5 >> 4);
+	b2[6] = (uint8_t)c->dig_H6;
+}
+
+int bme280_read_calib(int fd, uint16_t addr, bme280_calib_t *c)
+{
+	/* Both NVM blocks in a single combined transaction (4 messages) */
+	uint8_t r1 = BME280_CALIB00, r2 = BME280_CALIB26;
+	uint8_t b1[BME280_CALIB00_LEN], b2[BME280_CALIB26_LEN];
+	struct i2c_msg msgs[4] = {
+		{ .addr = addr, .flags = 0,        .len = 1,          .buf = &r1 },
+		{ .addr = addr, .flags = I2C_M_RD, .len = sizeof(b1), .buf = b1 },
+		{ .addr = addr, .flags = 0,        .len = 1,          .buf = &r2 },
+		{ .addr = addr, .flags = I2C_M_RD, .len = sizeof(b2), .buf = b2 },
+	};
+	struct i2c_rdwr_ioctl_data xfer = { .msgs = msgs, .nmsgs = 4 };
+	void *ctx;
+	const bme280_transport_t *t = transport_of(fd, addr, &ctx);
+
+	if (t == &spi_transport) {
+		/* Same over SPI: two chip-select cycles in one message */
+		const uint8_t regs[2] = { r1, r2 };
+		uint8_t *const bufs[2] = { b1, b2 };
+		const size_t lens[2] = { sizeof b1, sizeof b2 };
+		if (bus_counted(spi_read_blocks(fd, regs, bufs, lens, 2)) < 0) return -1;
+	} else if (t != &i2c_transport) {
+		if (bus_counted(t->read_regs(ctx, addr, r1, b1, sizeof b1)) < 0 ||
+		    bus_counted(t->read_regs(ctx, addr, r2, b2, sizeof b2)) < 0) return -1;
+	} else if (bus_counted(ioctl(fd, I2C_RDWR, &xfer) == 4 ? 0 : -1) < 0) {
+		return -1;
+	}
+
+	bme280_parse_calib(b1, b2, c);
+	return 0;
+}
+
+static uint8_t ctrl_meas(const bme280_settings_t *s, uint8_t mode)
+{
+	return (uint8_t)(((s->osrs_t & 0x07) << 5) | ((s->osrs_p & 0x07) << 2) | mode);
+}
+
+/* ctrl_hum only latches on the following ctrl_meas write, and config writes
+ * may be ignored outside sleep mode, so: ctrl_hum, config, then ctrl_meas. */
+int bme280_configure(int fd, uint16_t addr, const bme280_settings_t *s)
+{
+	uint8_t mode = (s->mode == BME280_MODE_NORMAL) ? BME280_MODE_NORMAL : BME280_MODE_SLEEP;
+	uint8_t config = (uint8_t)(((s->t_sb & 0x07) << 5) | ((s->filter & 0x07) << 2));
+	if (bme280_write_reg(fd, addr, BME280_REG_CTRL_HUM, s->osrs_h & 0x07) < 0) return -1;
+	if (bme280_write_reg(fd, addr, BME280_REG_CONFIG, config) < 0) return -1;
+	if (bme280_write_reg(fd, addr, BME280_REG_CTRL_MEAS, ctrl_meas(s, mode)) < 0) return -1;
+	return 0;
+}
+
+/* ---------------- Settings ---------------- */
+static const unsigned os_factor[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+static const unsigned iir_coef[8]  = {0, 2, 4, 8, 16, 16, 16, 16};
+/* t_sb codes 6 and 7 (10, 20 ms) are out of order in the datasheet table */
+static const unsigned sb_us[8]     = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+
+static int code_of(const unsigned *table, int n, unsigned v)
+{
+	for (int i = 0; i < n; i++) {
+		if (table[i] == v) return i;
+	}
+	return -1;
+}
+
+int bme280_osrs_code(unsigned factor)
+{
+	return code_of(os_factor, 6, factor);
+}
+
+int bme280_filter_code(unsigned coef)
+{
+	return code_of(iir_coef, 5, coef);
+}
+
+int bme280_standby_code(unsigned us)
+{
+	return code_of(sb_us, 8, us);
+}
+
+unsigned bme280_osrs_factor(uint8_t code)
+{
+	return os_factor[code & 0x07];
+}
+
+unsigned bme280_filter_coef(uint8_t code)
+{
+	return iir_coef[code & 0x07];
+}
+
+unsigned bme280_standby_us(uint8_t code)
+{
+	return sb_us[code & 0x07];
+}
+
+int bme280_preset(const char *name, bme280_settings_t *s)
+{
+	static const struct {
+		const char       *name;
+		bme280_settings_t s;
+	} presets[] = {
+		/* osrs_t, osrs_p, osrs_h, filter, t_sb, mode */
+		{ "weather",  { 1, 1, 1, 0, 0, BME280_MODE_FORCED } },   /* x1/x1/x1, filter off */
+		{ "humidity", { 1, 0, 1, 0, 0, BME280_MODE_FORCED } },   /* x1, P skipped, x1 */
+		{ "indoor",   { 2, 5, 1, 4, 0, BME280_MODE_NORMAL } },   /* x2/x16/x1, IIR 16, 0.5 ms */
+		{ "gaming",   { 1, 3, 0, 4, 0, BME280_MODE_NORMAL } },   /* x1/x4, H skipped, IIR 16, 0.5 ms */
+	};
+	for (size_t i = 0; i < sizeof presets / sizeof presets[0]; i++) {
+		if (strcmp(name, presets[i].name) == 0) {
+			*s = presets[i].s;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Datasheet 9.1: 1.25 + 2.3*T + (2.3*P + 0.575) + (2.3*H + 0.575) ms,
+ * skipped channels omitted */
+unsigned bme280_meas_time_us(const bme280_settings_t *s)
+{
+	unsigned t = 1250;
+	if (s->osrs_t) t += 2300 * os_factor[s->osrs_t & 0x07];
+	if (s->osrs_p) t += 2300 * os_factor[s->osrs_p & 0x07] + 575;
+	if (s->osrs_h) t += 2300 * os_factor[s->osrs_h & 0x07] + 575;
+	return t;
+}
+
+unsigned bme280_max_odr_mhz(const bme280_settings_t *s)
+{
+	unsigned cycle_us = bme280_meas_time_us(s);
+	if (s->mode == BME280_MODE_NORMAL) cycle_us += sb_us[s->t_sb & 0x07];
+	return (unsigned)(1000000000ull / cycle_us);
+}
+
+/* Write ctrl_meas with mode forced; returns without waiting */
+int bme280_trigger_forced(int fd, uint16_t addr, const bme280_settings_t *s)
+{
+	return bme280_write_reg(fd, addr, BME280_REG_CTRL_MEAS, ctrl_meas(s, BME280_MODE_FORCED));
+}
+
+/* Wait exactly the maximum conversion time, then check the measuring bit
+ * once (with a single short guard wait). */
+int bme280_measure_forced(int fd, uint16_t addr, const bme280_settings_t *s)
+{
+	if (bme280_trigger_forced(fd, addr, s) < 0) return -1;
+
+	unsigned wait_us = bme280_meas_time_us(s);
+	usleep(wait_us);
+
+	uint8_t st = 0;
+	if (bme280_read_reg(fd, addr, BME280_REG_STATUS, &st) < 0) return -1;
+	if (st & BME280_STATUS_MEASURING) usleep(wait_us / 8 + 500);
+	return 0;
+}
+
+/* ---------------- Data ---------------- */
+void bme280_parse_raw(const uint8_t *d, int32_t *adc_T, int32_t *adc_P, int32_t *adc_H)
+{
+	*adc_P = ((int32_t)d[0] << 12) | ((int32_t)d[1] << 4) | (d[2] >> 4);
+	*adc_T = ((int32_t)d[3] << 12) | ((int32_t)d[4] << 4) | (d[5] >> 4);
+	*adc_H = ((int32_t)d[6] << 8) | d[7];
+}
+
+int bme280_read_raw(int fd, uint16_t addr, int32_t *adc_T, int32_t *adc_P, int32_t *adc_H)
+{
+	uint8_t d[8];
+	if (bme280_read_regs(fd, addr, BME280_REG_PRESS_MSB, d, sizeof d) < 0) return -1;
+	bme280_parse_raw(d, adc_T, adc_P, adc_H);
+	return 0;
+}
+
+int bme280_read_data(int fd, uint16_t addr, unsigned poll_us, unsigned limit_us,
+                     uint8_t *raw, uint8_t *status)
+{
+	uint8_t b[BME280_BURST_LEN];
+	int bursts = 0;
+
+	for (unsigned waited = 0; ; waited += poll_us) {
+		if (bme280_read_regs(fd, addr, BME280_REG_STATUS, b, sizeof b) < 0) return -1;
+		bursts++;
+		if ((b[0] & BME280_STATUS_MEASURING) == 0 || waited >= limit_us || poll_us == 0) break;
+		usleep(poll_us);
+	}
+	memcpy(raw, b + (BME280_REG_PRESS_MSB - BME280_REG_STATUS), BME280_RAW_LEN);
+	if (status) *status = b[0];
+	return bursts;
+}
+
+/* ---------------- Compensation (datasheet 4.2.3 / 8.2) ---------------- */
+int32_t bme280_comp_T(int32_t adc_T, bme280_calib_t *c)
+{
+	c->t_fine = bme280_k_t_fine(adc_T, c);
+	return bme280_k_T(c->t_fine);
+}
+
+uint32_t bme280_comp_P(int32_t adc_P, const bme280_calib_t *c)
+{
+	return bme280_k_P(adc_P, c->t_fine, c);
+}
+
+uint32_t bme280_comp_H(int32_t adc_H, const bme280_calib_t *c)
+{
+	return bme280_k_H(adc_H, c->t_fine, c);
+}
+
+void bme280_compensate(bme280_calib_t *c, int32_t adc_T, int32_t adc_P, int32_t adc_H,
+                       bme280_data_t *out)
+{
+	out->temp  = bme280_comp_T(adc_T, c);
+	out->press = bme280_comp_P(adc_P, c);
+	out->humid = bme280_comp_H(adc_H, c);
+}
@@ -0,0 +1,182 @@
+/*
+ * libbme280.h: BME280 register map, I2C access, calibration and
+ * pure-integer compensation, shared by bpbme280 and bme280.
+ *
+ * Compensation follows the Bosch datasheet integer formulas and returns
+ * the raw fixed-point results; nothing here uses floating point:
+ *   temperature  int32   0.01 °C
+ *   pressure     uint32  Pa, Q24.8   (divide by 256 for Pa)
+ *   humidity     uint32  %RH, Q22.10 (divide by 1024 for %RH)
+ *
+ * All functions return 0 on success and -1 on I/O error unless noted.
+ */
+#ifndef LIBBME280_H
+#define LIBBME280_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ---------------- Registers ---------------- */
+#define BME280_CHIP_ID        0x60
+#define BME280_REG_ID         0xD0
+#define BME280_REG_RESET      0xE0
+#define BME280_REG_CTRL_HUM   0xF2
+#define BME280_REG_STATUS     0xF3
+#define BME280_REG_CTRL_MEAS  0xF4
+#define BME280_REG_CONFIG     0xF5
+#define BME280_REG_PRESS_MSB  0xF7  /* F7..F9 */
+#define BME280_REG_TEMP_MSB   0xFA  /* FA..FC */
+#define BME280_REG_HUM_MSB    0xFD  /* FD..FE */
+#define BME280_CALIB00        0x88  /* 0x88..0xA1 (26 bytes): T, P, H1 at 0xA1 */
+#define BME280_CALIB26        0xE1  /* 0xE1..0xE7 (7 bytes): H2..H6 */
+#define BME280_CALIB00_LEN    26
+#define BME280_CALIB26_LEN    7
+#define BME280_CALIB_LEN      (BME280_CALIB00_LEN + BME280_CALIB26_LEN)
+#define BME280_RAW_LEN        8     /* 0xF7..0xFE */
+#define BME280_BURST_LEN      12    /* 0xF3..0xFE: status, ctrl_meas, config, -, data */
+
+#define BME280_STATUS_MEASURING 0x08
+#define BME280_STATUS_IM_UPDATE 0x01
+#define BME280_MODE_SLEEP       0x00
+#define BME280_MODE_FORCED      0x01
+#define BME280_MODE_NORMAL      0x03
+
+/* ---------------- Types ---------------- */
+typedef struct {
+	/* Temperature */
+	uint16_t dig_T1; int16_t dig_T2; int16_t dig_T3;
+	/* Pressure */
+	uint16_t dig_P1; int16_t dig_P2; int16_t dig_P3; int16_t dig_P4; int16_t dig_P5;
+	int16_t dig_P6; int16_t dig_P7; int16_t dig_P8; int16_t dig_P9;
+	/* Humidity */
+	uint8_t  dig_H1; int16_t dig_H2; uint8_t dig_H3; int16_t dig_H4; int16_t dig_H5; int8_t dig_H6;
+	/* Shared: set by bme280_comp_T(), used by P and H */
+	int32_t t_fine;
+} bme280_calib_t;
+
+/* Register-level measurement settings (codes as written to the chip) */
+typedef struct {
+	uint8_t osrs_t, osrs_p, osrs_h;  /* 0 = skipped, 1..5 = x1,x2,x4,x8,x16 */
+	uint8_t filter;                  /* IIR coefficient code 0..4 */
+	uint8_t t_sb;                    /* standby code 0..7 (normal mode) */
+	uint8_t mode;                    /* BME280_MODE_FORCED or BME280_MODE_NORMAL */
+} bme280_settings_t;
+
+/* One compensated reading */
+typedef struct {
+	int32_t  temp;                   /* 0.01 °C */
+	uint32_t press;                  /* Pa, Q24.8 */
+	uint32_t humid;                  /* %RH, Q22.10 */
+} bme280_data_t;
+
+/* ---------------- Register access ---------------- */
+/* Every access goes through a transport. Built in: I2C (I2C_RDWR,
+ * repeated start) with addr the 7-bit slave address, or 4-wire SPI through
+ * spidev when addr is BME280_ADDR_SPI: one full-duplex SPI_IOC_MESSAGE per
+ * access, register address with bit 7 set to read and cleared to write
+ * (datasheet 6.3), auto-increment for bursts. Any other backend (e.g. the
+ * simulator, bme280sim.h) is attached to a descriptor and then serves
+ * every access on it. */
+#define BME280_ADDR_SPI  0xFFFF
+#define BME280_SPI_HZ    10000000    /* datasheet maximum SCK */
+
+typedef struct {
+	int  (*read_regs)(void *ctx, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len);
+	int  (*write_reg)(void *ctx, uint16_t addr, uint8_t reg, uint8_t val);
+	void (*close)(void *ctx);        /* may be NULL */
+} bme280_transport_t;
+
+/* Route fd's accesses to t (at most 16 descriptors; attach before any
+ * sampling thread starts). 0 or -1. */
+int  bme280_transport_attach(int fd, const bme280_transport_t *t, void *ctx);
+/* Detach (closing the backend) and close fd; works on any descriptor */
+int  bme280_close(int fd);
+
+/* Transactions (one per register access; I2C_RDWR ioctl, SPI message or
+ * backend call) and failed ones since start, all descriptors */
+typedef struct {
+	uint64_t transactions;
+	uint64_t errors;
+} bme280_bus_stats_t;
+
+void bme280_bus_stats(bme280_bus_stats_t *st);
+
+int bme280_write_reg(int fd, uint16_t addr, uint8_t reg, uint8_t val);
+int bme280_read_regs(int fd, uint16_t addr, uint8_t start_reg, uint8_t *buf, size_t len);
+int bme280_read_reg(int fd, uint16_t addr, uint8_t reg, uint8_t *val);
+/* SPI mode 0, 8 bits per word, hz on an open spidev descriptor */
+int bme280_spi_setup(int fd, uint32_t hz);
+
+/* ---------------- Setup ---------------- */
+/* Decode the two NVM blocks (26 + 7 bytes) into c */
+void bme280_parse_calib(const uint8_t *b1, const uint8_t *b2, bme280_calib_t *c);
+/* Inverse of bme280_parse_calib(): the 33-byte NVM image (CALIB00 block
+ * then CALIB26 block) for c; the reserved byte 0xA0 is written as 0 */
+void bme280_pack_calib(const bme280_calib_t *c, uint8_t *raw);
+/* Read both NVM blocks in one combined transaction and decode them */
+int  bme280_read_calib(int fd, uint16_t addr, bme280_calib_t *c);
+/* Write ctrl_hum, config, ctrl_meas; forced mode leaves the chip asleep */
+int  bme280_configure(int fd, uint16_t addr, const bme280_settings_t *s);
+/* Datasheet maximum measurement time for s, in microseconds */
+unsigned bme280_meas_time_us(const bme280_settings_t *s);
+/* Register codes for datasheet values; -1 if a value has no code */
+int  bme280_osrs_code(unsigned factor);          /* 0 (skipped), 1, 2, 4, 8, 16 */
+int  bme280_filter_code(unsigned coef);          /* 0 (off), 2, 4, 8, 16 */
+int  bme280_standby_code(unsigned us);           /* 500, 10000, 20000, 62500, ... 1000000 */
+/* ... and back */
+unsigned bme280_osrs_factor(uint8_t code);
+unsigned bme280_filter_coef(uint8_t code);
+unsigned bme280_standby_us(uint8_t code);
+/* Bosch recommended modes of operation (datasheet 3.5): "weather",
+ * "humidity", "indoor" (navigation) or "gaming". 0, or -1 if unknown. */
+int  bme280_preset(const char *name, bme280_settings_t *s);
+/* Highest output data rate for s in mHz: one measurement per conversion
+ * (forced) or per conversion plus standby (normal, datasheet 9.2) */
+unsigned bme280_max_odr_mhz(const bme280_settings_t *s);
+/* Start one forced conversion without waiting (several sensors on a bus
+ * can convert at once) */
+int  bme280_trigger_forced(int fd, uint16_t addr, const bme280_settings_t *s);
+/* Trigger one forced conversion and wait for it */
+int  bme280_measure_forced(int fd, uint16_t addr, const bme280_settings_t *s);
+
+/* ---------------- Data ---------------- */
+/* Decode the 8 data bytes of 0xF7..0xFE into 20/20/16-bit ADC values */
+void bme280_parse_raw(const uint8_t *d, int32_t *adc_T, int32_t *adc_P, int32_t *adc_H);
+int  bme280_read_raw(int fd, uint16_t addr, int32_t *adc_T, int32_t *adc_P, int32_t *adc_H);
+/* Status and data registers (0xF3..0xFE) in one burst, so the status bits
+ * describe the data they arrive with. Only while a conversion is in
+ * progress (measuring bit) is the burst repeated, every poll_us for at most
+ * limit_us. raw gets the BME280_RAW_LEN data bytes, *status (may be NULL)
+ * the status byte of the last burst. Returns bursts issued, or -1. */
+int  bme280_read_data(int fd, uint16_t addr, unsigned poll_us, unsigned limit_us,
+                      uint8_t *raw, uint8_t *status);
+
+/* ---------------- Compensation (integer only) ---------------- */
+int32_t  bme280_comp_T(int32_t adc_T, bme280_calib_t *c);   /* updates c->t_fine */
+uint32_t bme280_comp_P(int32_t adc_P, const bme280_calib_t *c);
+uint32_t bme280_comp_H(int32_t adc_H, const bme280_calib_t *c);
+/* T, then P and H with the matching t_fine */
+void     bme280_compensate(bme280_calib_t *c, int32_t adc_T, int32_t adc_P, int32_t adc_H,
+                           bme280_data_t *out);
+
+/* ---------------- Batch compensation (bme280_batch.c) ---------------- */
+/* Structure-of-arrays: n raw triplets in, n fixed-point results out. No
+ * hidden state (t_fine is per sample and c is not modified), so the AVX2
+ * and NEON kernels can vectorize T and H; results are bit-exact with the
+ * per-sample functions above. */
+#define BME280_KERNEL_AUTO   0          /* best available on this CPU */
+#define BME280_KERNEL_SCALAR 1
+#define BME280_KERNEL_AVX2   2
+#define BME280_KERNEL_NEON   3
+
+int  bme280_batch_kernel_available(int kernel);
+const char *bme280_batch_kernel_name(int kernel);
+/* Returns 0, or -1 if the kernel is not available on this build/CPU */
+int  bme280_compensate_batch_with(int kernel, const bme280_calib_t *c,
+                                  const int32_t *adc_T, const int32_t *adc_P, const int32_t *adc_H,
+                                  size_t n, int32_t *temp, uint32_t *press, uint32_t *humid);
+void bme280_compensate_batch(const bme280_calib_t *c,
+                             const int32_t *adc_T, const int32_t *adc_P, const int32_t *adc_H,
+                             size_t n, int32_t *temp, uint32_t *press, uint32_t *humid);
+
+#endif /* LIBBME280_H */
@@ -0,0 +1,100 @@
+/*
+ * metrics.c: Prometheus textfile output (see metrics.h).
+ *
+ * Counters and histograms are read one word at a time, so a snapshot can
+ * be a few events apart between series; each histogram's _count is the
+ * sum of its own buckets, so it always agrees with its +Inf bucket.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libbme280.h"
+#include "metrics.h"
+
+_Atomic uint64_t metrics_counter[MC_COUNT];
+_Atomic uint64_t metrics_bucket[MH_COUNT][METRICS_BUCKETS + 1];
+_Atomic uint64_t metrics_sum_ns[MH_COUNT];
+
+static const struct {
+	const char *name, *help;
+} counter_info[MC_COUNT] = {
+	[MC_SAMPLES]         = { "bpbme280_samples_total", "Sensor readings read successfully." },
+	[MC_SAMPLE_FAILURES] = { "bpbme280_sample_failures_total", "Sensor readings that failed." },
+	[MC_READ_RETRIES]    = { "bpbme280_read_retries_total", "Status+data bursts repeated because a conversion was still running." },
+	[MC_BUNDLES]         = { "bpbme280_bundles_sent_total", "Bundles accepted by bp_send()." },
+	[MC_BYTES]           = { "bpbme280_bytes_sent_total", "Payload bytes of the bundles sent." },
+	[MC_SEND_FAILURES]   = { "bpbme280_send_failures_total", "Payloads BP refused or failed on." },
+	[MC_NOSPACE]         = { "bpbme280_zco_nospace_total", "Payloads that found no SDR/ZCO space (spilled)." },
+	[MC_RING_DROPPED]    = { "bpbme280_ring_dropped_total", "Records dropped because the sampler ring was full." },
+	[MC_SPILL_DROPPED]   = { "bpbme280_spill_dropped_total", "Spill file entries dropped because they could not be read." },
+};
+
+static const struct {
+	const char *name, *help;
+} hist_info[MH_COUNT] = {
+	[MH_CONVERSION] = { "bpbme280_conversion_wait_seconds", "Trigger (forced) or read start (normal) until the data are read." },
+	[MH_SETTLE]     = { "bpbme280_settle_wait_seconds", "Normal-mode settle wait at start-up." },
+	[MH_SDR_XN]     = { "bpbme280_sdr_xn_seconds", "SDR transaction writing a payload extent." },
+	[MH_ZCO]        = { "bpbme280_zco_wait_seconds", "ionCreateZco(), including waiting on the attendant for space." },
+	[MH_SEND]       = { "bpbme280_send_seconds", "bp_send()." },
+};
+
+static uint64_t load(_Atomic uint64_t *v)
+{
+	return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+static void put_counter(FILE *f, const char *name, const char *help, uint64_t v)
+{
+	fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, (unsigned long long)v);
+}
+
+static void put_hist(FILE *f, int h)
+{
+	const char *name = hist_info[h].name;
+	uint64_t cum = 0;
+
+	fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", name, hist_info[h].help, name);
+	for (int i = 0; i < METRICS_BUCKETS; i++) {
+		cum += load(&metrics_bucket[h][i]);
+		fprintf(f, "%s_bucket{le=\"%g\"} %llu\n", name,
+		        (double)((uint64_t)METRICS_BUCKET0_US << i) / 1e6, (unsigned long long)cum);
+	}
+	cum += load(&metrics_bucket[h][METRICS_BUCKETS]);
+	fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cum);
+	fprintf(f, "%s_sum %.9f\n%s_count %llu\n", name, (double)load(&metrics_sum_ns[h]) / 1e9,
+	        name, (unsigned long long)cum);
+}
+
+int metrics_write(const char *path)
+{
+	char tmp[272];
+	bme280_bus_stats_t bus;
+
+	snprintf(tmp, sizeof tmp, "%s.%ld", path, (long)getpid());
+	FILE *f = fopen(tmp, "we");
+	if (!f) return -1;
+
+	bme280_bus_stats(&bus);
+	put_counter(f, "bpbme280_bus_transactions_total", "I2C/SPI register transactions.", bus.transactions);
+	put_counter(f, "bpbme280_bus_errors_total", "I2C/SPI register transactions that failed.", bus.errors);
+	for (int c = 0; c < MC_COUNT; c++) {
+		put_counter(f, counter_info[c].name, counter_info[c].help, load(&metrics_counter[c]));
+	}
+	for (int h = 0; h < MH_COUNT; h++) put_hist(f, h);
+	fprintf(f, "# HELP bpbme280_metrics_write_timestamp_seconds When this file was written (UNIX time).\n"
+	           "# TYPE bpbme280_metrics_write_timestamp_seconds gauge\n"
+	           "bpbme280_metrics_write_timestamp_seconds %lld\n", (long long)time(NULL));
+
+	int ok = (fflush(f) == 0 && !ferror(f));
+	if (fclose(f) != 0) ok = 0;
+	if (!ok || rename(tmp, path) < 0) {
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * metrics.h: Run-time counters and latency histograms, written as a
+ * Prometheus textfile-collector file.
+ *
+ * Recording is a relaxed atomic add into process-wide arrays (histograms
+ * use fixed power-of-two buckets, found with one count-leading-zeros), so
+ * the sampling and BP threads never lock or allocate for it. The file is
+ * rendered from a snapshot and replaced atomically (write + rename), so
+ * the collector never reads a half-written file.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#define METRICS_PERIOD_SEC 10
+
+typedef enum {
+	MC_SAMPLES,                  /* sensor readings read successfully */
+	MC_SAMPLE_FAILURES,          /* sensor readings that failed */
+	MC_READ_RETRIES,             /* extra status+data bursts while measuring */
+	MC_BUNDLES,                  /* bundles accepted by bp_send() */
+	MC_BYTES,                    /* their payload bytes */
+	MC_SEND_FAILURES,            /* payloads BP refused or errored on */
+	MC_NOSPACE,                  /* payloads that found no SDR/ZCO space */
+	MC_RING_DROPPED,             /* set: records the full ring rejected */
+	MC_SPILL_DROPPED,            /* spill entries dropped as unreadable */
+	MC_COUNT
+} metrics_counter_t;
+
+typedef enum {
+	MH_CONVERSION,               /* conversion wait: trigger (or read start) to data in */
+	MH_SETTLE,                   /* normal-mode settle wait at start-up */
+	MH_SDR_XN,                   /* SDR transaction for the payload extent */
+	MH_ZCO,                      /* ionCreateZco(), incl. waiting for space */
+	MH_SEND,                     /* bp_send() */
+	MH_COUNT
+} metrics_hist_t;
+
+/* Bucket i counts values up to METRICS_BUCKET0_US << i; the last is +Inf */
+#define METRICS_BUCKET0_US 16
+#define METRICS_BUCKETS    18
+
+extern _Atomic uint64_t metrics_counter[MC_COUNT];
+extern _Atomic uint64_t metrics_bucket[MH_COUNT][METRICS_BUCKETS + 1];
+extern _Atomic uint64_t metrics_sum_ns[MH_COUNT];
+
+static inline int64_t metrics_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void metrics_add(metrics_counter_t c, uint64_t n)
+{
+	atomic_fetch_add_explicit(&metrics_counter[c], n, memory_order_relaxed);
+}
+
+static inline void metrics_set(metrics_counter_t c, uint64_t v)
+{
+	atomic_store_explicit(&metrics_counter[c], v, memory_order_relaxed);
+}
+
+/* One latency, from a metrics_now() taken at its start */
+static inline void metrics_observe(metrics_hist_t h, int64_t start_ns)
+{
+	int64_t ns = metrics_now() - start_ns;
+	uint64_t us = (ns > 0) ? (uint64_t)ns / 1000 : 0;
+	int i = 0;
+	if (us > METRICS_BUCKET0_US) {
+		i = 64 - __builtin_clzll(us - 1) - 4;   /* log2(METRICS_BUCKET0_US) */
+		if (i > METRICS_BUCKETS) i = METRICS_BUCKETS;
+	}
+	atomic_fetch_add_explicit(&metrics_bucket[h][i], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics_sum_ns[h], (uint64_t)(ns > 0 ? ns : 0), memory_order_relaxed);
+}
+
+/* Render everything (and the bus counters of libbme280) to path. 0 or -1. */
+int metrics_write(const char *path);
+
+#endif /* METRICS_H */
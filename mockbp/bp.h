@@ -0,0 +1,88 @@
+/*
+ * bp.h: Stand-in for ION's bp.h, declaring only what bpbme280 uses, for
+ * building against the mock BP library (mockbp.h) on a machine without
+ * ION. Types and signatures follow ION's (bpv7/include/bp.h, ici/include
+ * zco.h, sdr.h, platform.h) closely enough that bpbme280.c compiles
+ * unchanged against either.
+ */
+#ifndef _BP_H_
+#define _BP_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* ---------------- platform.h ---------------- */
+#define ERROR          (-1)
+#define oK(x)          ((void)(x))
+#define PUTS(text)     puts(text)
+#define CHKZERO(e)     if (!(e)) return 0
+
+typedef long long      vast;
+typedef unsigned long  Object;
+typedef void         (*SignalHandler)(int);
+
+extern void isignal(int signbr, SignalHandler handler);
+extern void putErrmsg(const char *text, const char *arg);
+extern void writeErrmsgMemos(void);
+
+/* ---------------- sdr.h ---------------- */
+typedef struct mockbp_sdr *Sdr;
+
+extern int    sdr_begin_xn(Sdr sdr);
+extern int    sdr_end_xn(Sdr sdr);
+extern void   sdr_cancel_xn(Sdr sdr);
+extern Object sdr_malloc(Sdr sdr, size_t size);
+extern void   sdr_write(Sdr sdr, Object into, char *from, long length);
+extern void   sdr_free(Sdr sdr, Object object);
+
+/* ---------------- zco.h / ion.h ---------------- */
+typedef enum {
+	ZcoFileSource = 1,
+	ZcoBulkSource,
+	ZcoObjSource,
+	ZcoSdrSource,
+	ZcoZcoSource
+} ZcoMedium;
+
+typedef enum {
+	ZcoInbound = 0,
+	ZcoOutbound,
+	ZcoUnknown
+} ZcoAcct;
+
+typedef struct {
+	int paused;
+} ReqAttendant;
+
+extern int    ionStartAttendant(ReqAttendant *attendant);
+extern void   ionPauseAttendant(ReqAttendant *attendant);
+extern void   ionStopAttendant(ReqAttendant *attendant);
+extern Object ionCreateZco(ZcoMedium source, Object location, vast offset, vast length,
+                           int priority, unsigned char flowLabel, ZcoAcct acct,
+                           ReqAttendant *attendant);
+
+/* ---------------- bp.h ---------------- */
+#define BP_BULK_PRIORITY     0
+#define BP_STD_PRIORITY      1
+#define BP_EXPEDITED_PRIORITY 2
+
+typedef enum {
+	NoCustodyRequested = 0,
+	SourceCustodyOptional,
+	SourceCustodyRequired
+} BpCustodySwitch;
+
+typedef struct mockbp_sap *BpSAP;
+typedef struct BpAncillaryData BpAncillaryData;
+
+extern int  bp_attach(void);
+extern void bp_detach(void);
+extern Sdr  bp_get_sdr(void);
+extern int  bp_open_source(char *eid, BpSAP *ionsapPtr, int detain);
+extern void bp_close(BpSAP sap);
+extern int  bp_send(BpSAP sap, char *destEid, char *reportToEid, int lifespan,
+                    int classOfService, BpCustodySwitch custodySwitch,
+                    unsigned char srrFlags, int ackRequested,
+                    BpAncillaryData *ancillaryData, Object adu, Object *newBundle);
+
+#endif /* _BP_H_ */
@@ -0,0 +1,405 @@
+/*
+ * mockbp.c: Mock ION BP library (see mockbp.h).
+ *
+ * SDR objects are heap blocks (the Object is the pointer), a ZCO is a
+ * small heap record naming its extent, and bp_send() takes the ZCO over
+ * as ION does: the payload is recorded and the extent and ZCO are freed.
+ * The calls are made from one thread in bpbme280, but a benchmark may read
+ * the counters from another, so state is under one mutex; injected
+ * latencies are spun outside it.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mockbp.h"
+
+#define ZCO_WAIT_US 1000             /* attendant poll while out of space */
+
+struct mockbp_sdr {
+	int in_xn;
+};
+
+struct mockbp_sap {
+	char eid[64];
+};
+
+typedef struct {
+	Object extent;
+	size_t len;
+} mock_zco_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  once = PTHREAD_ONCE_INIT;
+static mockbp_config_t cfg;
+static int             configured;
+static mockbp_stats_t  stats;
+static struct mockbp_sdr sdr_obj;
+
+/* In memory: a ring of the last cfg.keep bundles */
+static mockbp_bundle_t *kept;
+static size_t           kept_head, kept_n;
+static uint64_t         seq;
+static int64_t          drained_ns;  /* ZCO space accounted up to here */
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Busy-wait: a sleep would add the scheduler's wake-up latency, which
+ * varies from run to run */
+static void spin_us(unsigned us)
+{
+	if (us == 0) return;
+	int64_t until = now_ns() + (int64_t)us * 1000;
+	while (now_ns() < until) { }
+}
+
+/* ---------------- Settings ---------------- */
+static unsigned long long env_num(const char *name, unsigned long long dflt)
+{
+	const char *v = getenv(name);
+	if (!v || *v == '\0') return dflt;
+	char *end;
+	unsigned long long x = strtoull(v, &end, 0);
+	if (*end != '\0') {
+		fprintf(stderr, "[?] mockbp: ignoring %s=%s\n", name, v);
+		return dflt;
+	}
+	return x;
+}
+
+void mockbp_config_env(mockbp_config_t *c)
+{
+	memset(c, 0, sizeof *c);
+	c->out_dir = getenv("MOCKBP_OUT");
+	if (c->out_dir && *c->out_dir == '\0') c->out_dir = NULL;
+	c->keep = (size_t)env_num("MOCKBP_KEEP", MOCKBP_KEEP_DEFAULT);
+	c->xn_us = (unsigned)env_num("MOCKBP_XN_US", 0);
+	c->zco_us = (unsigned)env_num("MOCKBP_ZCO_US", 0);
+	c->send_us = (unsigned)env_num("MOCKBP_SEND_US", 0);
+	c->zco_bytes = env_num("MOCKBP_ZCO_BYTES", 0);
+	c->drain_bps = env_num("MOCKBP_DRAIN_BPS", 0);
+	c->attach_fail = (unsigned)env_num("MOCKBP_ATTACH_FAIL", 0);
+	c->report = (int)env_num("MOCKBP_REPORT", 0);
+}
+
+static void config_apply(const mockbp_config_t *c)
+{
+	cfg = *c;
+	free(kept);
+	kept = (cfg.keep > 0) ? calloc(cfg.keep, sizeof *kept) : NULL;
+	if (!kept) cfg.keep = 0;
+	kept_head = kept_n = 0;
+	if (cfg.out_dir) (void)mkdir(cfg.out_dir, 0755);
+	configured = 1;
+}
+
+static void init_env(void)
+{
+	pthread_mutex_lock(&lock);
+	if (!configured) {
+		mockbp_config_t c;
+		mockbp_config_env(&c);
+		config_apply(&c);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+static void mock_init(void)
+{
+	pthread_once(&once, init_env);
+}
+
+void mockbp_configure(const mockbp_config_t *c)
+{
+	pthread_mutex_lock(&lock);
+	config_apply(c);
+	pthread_mutex_unlock(&lock);
+}
+
+/* ---------------- Recorded bundles ---------------- */
+static void kept_clear(void)
+{
+	for (size_t i = 0; i < kept_n; i++) {
+		free((void *)kept[(kept_head + i) % cfg.keep].data);
+	}
+	kept_head = kept_n = 0;
+}
+
+/* Takes data over (caller's lock held) */
+static void record(uint8_t *data, size_t len, int64_t ns)
+{
+	stats.bundles++;
+	stats.bytes += len;
+	seq++;
+
+	if (cfg.out_dir) {
+		char path[512];
+		snprintf(path, sizeof path, "%s/bundle-%06llu.bin", cfg.out_dir, (unsigned long long)seq);
+		int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0 || write(fd, data, len) != (ssize_t)len) {
+			fprintf(stderr, "[?] mockbp: can't write %s: %s\n", path, strerror(errno));
+		}
+		if (fd >= 0) close(fd);
+		free(data);
+		return;
+	}
+	if (cfg.keep == 0) {
+		free(data);
+		return;
+	}
+	if (kept_n == cfg.keep) {                   /* evict the oldest */
+		free((void *)kept[kept_head].data);
+		kept_head = (kept_head + 1) % cfg.keep;
+		kept_n--;
+	}
+	mockbp_bundle_t *b = &kept[(kept_head + kept_n++) % cfg.keep];
+	b->data = data;
+	b->len = len;
+	b->sent_ns = ns;
+	b->seq = seq;
+}
+
+void mockbp_get_stats(mockbp_stats_t *st)
+{
+	pthread_mutex_lock(&lock);
+	*st = stats;
+	pthread_mutex_unlock(&lock);
+}
+
+size_t mockbp_count(void)
+{
+	pthread_mutex_lock(&lock);
+	size_t n = kept_n;
+	pthread_mutex_unlock(&lock);
+	return n;
+}
+
+int mockbp_bundle(size_t i, mockbp_bundle_t *b)
+{
+	pthread_mutex_lock(&lock);
+	int ok = (i < kept_n);
+	if (ok) *b = kept[(kept_head + i) % cfg.keep];
+	pthread_mutex_unlock(&lock);
+	return ok ? 0 : -1;
+}
+
+void mockbp_reset(void)
+{
+	pthread_mutex_lock(&lock);
+	kept_clear();
+	memset(&stats, 0, sizeof stats);
+	seq = 0;
+	drained_ns = now_ns();
+	pthread_mutex_unlock(&lock);
+}
+
+/* ---------------- platform ---------------- */
+void isignal(int signbr, SignalHandler handler)
+{
+	struct sigaction action;
+	sigset_t signals;
+
+	sigemptyset(&signals);
+	sigaddset(&signals, signbr);
+	oK(pthread_sigmask(SIG_UNBLOCK, &signals, NULL));
+	memset(&action, 0, sizeof action);
+	action.sa_handler = handler;
+	oK(sigaction(signbr, &action, NULL));
+}
+
+void putErrmsg(const char *text, const char *arg)
+{
+	if (arg) fprintf(stderr, "%s (%s)\n", text, arg);
+	else fprintf(stderr, "%s\n", text);
+}
+
+void writeErrmsgMemos(void)
+{
+}
+
+/* ---------------- SDR ---------------- */
+int sdr_begin_xn(Sdr sdr)
+{
+	spin_us(cfg.xn_us);
+	sdr->in_xn = 1;
+	return 1;
+}
+
+int sdr_end_xn(Sdr sdr)
+{
+	sdr->in_xn = 0;
+	return 0;
+}
+
+void sdr_cancel_xn(Sdr sdr)
+{
+	sdr->in_xn = 0;
+}
+
+Object sdr_malloc(Sdr sdr, size_t size)
+{
+	(void)sdr;
+	return (Object)malloc(size ? size : 1);
+}
+
+void sdr_write(Sdr sdr, Object into, char *from, long length)
+{
+	(void)sdr;
+	memcpy((void *)into, from, (size_t)length);
+}
+
+void sdr_free(Sdr sdr, Object object)
+{
+	(void)sdr;
+	free((void *)object);
+}
+
+/* ---------------- ZCO ---------------- */
+int ionStartAttendant(ReqAttendant *attendant)
+{
+	attendant->paused = 0;
+	return 0;
+}
+
+void ionPauseAttendant(ReqAttendant *attendant)
+{
+	attendant->paused = 1;
+}
+
+void ionStopAttendant(ReqAttendant *attendant)
+{
+	(void)attendant;
+}
+
+/* Release the space drained since the last call (lock held) */
+static void zco_drain(int64_t now)
+{
+	if (cfg.drain_bps == 0) {
+		drained_ns = now;
+		return;
+	}
+	uint64_t gone = (uint64_t)((double)(now - drained_ns) * cfg.drain_bps / 1e9);
+	if (gone == 0) return;
+	stats.zco_in_use = (gone >= stats.zco_in_use) ? 0 : stats.zco_in_use - gone;
+	drained_ns = now;
+}
+
+Object ionCreateZco(ZcoMedium source, Object location, vast offset, vast length,
+                    int priority, unsigned char flowLabel, ZcoAcct acct,
+                    ReqAttendant *attendant)
+{
+	(void)priority;
+	(void)flowLabel;
+	(void)acct;
+	mock_init();
+	if (source != ZcoSdrSource || offset != 0 || length <= 0) return (Object)ERROR;
+	spin_us(cfg.zco_us);
+
+	int64_t t0 = now_ns();
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		zco_drain(now_ns());
+		if (cfg.zco_bytes == 0 || stats.zco_in_use + (uint64_t)length <= cfg.zco_bytes) break;
+		if (!attendant || attendant->paused) {
+			stats.nospace++;
+			pthread_mutex_unlock(&lock);
+			return 0;
+		}
+		pthread_mutex_unlock(&lock);
+		usleep(ZCO_WAIT_US);
+		pthread_mutex_lock(&lock);
+	}
+	stats.zco_in_use += (uint64_t)length;
+	stats.blocked_ns += (uint64_t)(now_ns() - t0);
+	pthread_mutex_unlock(&lock);
+
+	mock_zco_t *z = malloc(sizeof *z);
+	if (!z) return (Object)ERROR;
+	z->extent = location;
+	z->len = (size_t)length;
+	return (Object)z;
+}
+
+/* ---------------- BP ---------------- */
+int bp_attach(void)
+{
+	mock_init();
+	pthread_mutex_lock(&lock);
+	int fail = (stats.attach_failed < cfg.attach_fail);
+	if (fail) stats.attach_failed++;
+	else drained_ns = now_ns();
+	pthread_mutex_unlock(&lock);
+	return fail ? -1 : 0;
+}
+
+void bp_detach(void)
+{
+	mockbp_stats_t st;
+	if (!cfg.report) return;
+	mockbp_get_stats(&st);
+	fprintf(stderr, "[i] mockbp: %llu bundle(s), %llu bytes; %llu ZCO(s) refused, %.3f ms blocked on ZCO space; %llu failed attach(es)\n",
+	        (unsigned long long)st.bundles, (unsigned long long)st.bytes,
+	        (unsigned long long)st.nospace, (double)st.blocked_ns / 1e6,
+	        (unsigned long long)st.attach_failed);
+}
+
+Sdr bp_get_sdr(void)
+{
+	return &sdr_obj;
+}
+
+int bp_open_source(char *eid, BpSAP *ionsapPtr, int detain)
+{
+	(void)detain;
+	struct mockbp_sap *sap = calloc(1, sizeof *sap);
+	if (!sap) return -1;
+	snprintf(sap->eid, sizeof sap->eid, "%s", eid);
+	*ionsapPtr = sap;
+	return 0;
+}
+
+void bp_close(BpSAP sap)
+{
+	free(sap);
+}
+
+int bp_send(BpSAP sap, char *destEid, char *reportToEid, int lifespan,
+            int classOfService, BpCustodySwitch custodySwitch,
+            unsigned char srrFlags, int ackRequested,
+            BpAncillaryData *ancillaryData, Object adu, Object *newBundle)
+{
+	(void)reportToEid;
+	(void)classOfService;
+	(void)custodySwitch;
+	(void)srrFlags;
+	(void)ackRequested;
+	(void)ancillaryData;
+	if (!sap || !destEid || lifespan <= 0 || adu == 0 || adu == (Object)ERROR) return -1;
+	spin_us(cfg.send_us);
+
+	/* The ZCO is consumed: its extent becomes the recorded payload */
+	mock_zco_t *z = (mock_zco_t *)adu;
+	uint8_t *data = (uint8_t *)z->extent;
+	size_t len = z->len;
+	free(z);
+
+	pthread_mutex_lock(&lock);
+	record(data, len, now_ns());
+	*newBundle = (Object)seq;
+	pthread_mutex_unlock(&lock);
+	return 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * mockbp.h: Link-time replacement for the parts of ION bpbme280 uses
+ * (bp.h in this directory), for running and benchmarking the send path on
+ * any Linux machine.
+ *
+ * Bundles handed to bp_send() are recorded, in memory (the most recent
+ * `keep` of them) or as one file per bundle, and counted. Every ION call
+ * on the send path can be given a fixed latency, spun on CLOCK_MONOTONIC
+ * so it is the same on every run, and outbound ZCO space can be limited:
+ * ZCOs occupy their length until drained at a fixed rate, and a ZCO that
+ * does not fit is refused at once (no attendant) or blocks until it fits
+ * or the attendant is paused, as in ION.
+ *
+ * The settings come from the environment at the first call, or from
+ * mockbp_configure():
+ *   MOCKBP_OUT=<dir>        write bundles to <dir>/bundle-NNNNNN.bin
+ *   MOCKBP_KEEP=<n>         bundles kept in memory (default 4096)
+ *   MOCKBP_XN_US=<us>       latency of sdr_begin_xn()
+ *   MOCKBP_ZCO_US=<us>      latency of ionCreateZco()
+ *   MOCKBP_SEND_US=<us>     latency of bp_send()
+ *   MOCKBP_ZCO_BYTES=<n>    outbound ZCO space (default 0 = unlimited)
+ *   MOCKBP_DRAIN_BPS=<n>    rate ZCO space frees up (default 0 = never)
+ *   MOCKBP_ATTACH_FAIL=<n>  fail the first n bp_attach() calls
+ *   MOCKBP_REPORT=1         print the counters at bp_detach()
+ */
+#ifndef MOCKBP_H
+#define MOCKBP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bp.h"
+
+#define MOCKBP_KEEP_DEFAULT 4096
+
+typedef struct {
+	const char *out_dir;         /* NULL: memory */
+	size_t      keep;
+	unsigned    xn_us, zco_us, send_us;
+	uint64_t    zco_bytes;       /* 0: unlimited */
+	uint64_t    drain_bps;
+	unsigned    attach_fail;
+	int         report;
+} mockbp_config_t;
+
+typedef struct {
+	uint64_t bundles;            /* accepted by bp_send() */
+	uint64_t bytes;              /* their payload */
+	uint64_t nospace;            /* ZCOs refused for lack of space */
+	uint64_t blocked_ns;         /* time ionCreateZco() waited for space */
+	uint64_t attach_failed;
+	uint64_t zco_in_use;         /* bytes, now */
+} mockbp_stats_t;
+
+/* One recorded bundle; data stays valid until it is evicted or reset */
+typedef struct {
+	const uint8_t *data;
+	size_t         len;
+	int64_t        sent_ns;      /* CLOCK_MONOTONIC at bp_send() */
+	uint64_t       seq;          /* 1, 2, ... in send order */
+} mockbp_bundle_t;
+
+/* Replace the settings (call before the first BP call) */
+void   mockbp_configure(const mockbp_config_t *cfg);
+/* Settings from the environment, as used when mockbp_configure() is not */
+void   mockbp_config_env(mockbp_config_t *cfg);
+void   mockbp_get_stats(mockbp_stats_t *st);
+/* Bundles held in memory, oldest first */
+size_t mockbp_count(void);
+int    mockbp_bundle(size_t i, mockbp_bundle_t *b);
+/* Drop recorded bundles and zero the counters and ZCO space in use */
+void   mockbp_reset(void);
+
+#endif /* MOCKBP_H */
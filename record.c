@@ -0,0 +1,206 @@
+/*
+ * record.c: Encode one sample as a JSON or CBOR record (see record.h).
+ *
+ * Both encoders work on the integer fixed-point sample directly; values are
+ * rounded half away from zero to the wire precision.
+ */
+
+#include "cbor.h"
+#include "jsonw.h"
+#include "libbme280.h"
+#include "record.h"
+
+void rec_to_wire(const sample_t *s, int64_t v[REC_KEY_LOC])
+{
+	v[REC_KEY_TS]       = s->ts;
+	v[REC_KEY_TEMP]     = jw_round_div(s->temp, 100 / REC_SCALE_TEMP);
+	v[REC_KEY_PRESS]    = jw_round_div((int64_t)s->press * REC_SCALE_PRESS, 256 * 100);
+	v[REC_KEY_HUMID]    = jw_round_div((int64_t)s->humid * REC_SCALE_HUMID, 1024);
+	v[REC_KEY_CPU_TEMP] = jw_round_div(s->cpu_temp, 1000 / REC_SCALE_CPU_TEMP);
+	v[REC_KEY_LOAD]     = s->load;
+}
+
+void rec_from_wire(const int64_t v[REC_KEY_LOC], sample_t *s)
+{
+	s->ts       = v[REC_KEY_TS];
+	s->temp     = (int32_t)(v[REC_KEY_TEMP] * (100 / REC_SCALE_TEMP));
+	s->press    = (uint32_t)(v[REC_KEY_PRESS] * (256 * 100 / REC_SCALE_PRESS));
+	s->humid    = (uint32_t)jw_round_div(v[REC_KEY_HUMID] * 1024, REC_SCALE_HUMID);
+	s->cpu_temp = (int32_t)(v[REC_KEY_CPU_TEMP] * (1000 / REC_SCALE_CPU_TEMP));
+	s->load     = (int32_t)v[REC_KEY_LOAD];
+}
+
+void rec_to_summary_units(const sample_t *s, double x[REC_KEY_LOC])
+{
+	x[REC_KEY_TS]       = (double)s->ts;
+	x[REC_KEY_TEMP]     = s->temp * (REC_SCALE_TEMP * REC_SUM_FINER / 100.0);
+	x[REC_KEY_PRESS]    = s->press * (REC_SCALE_PRESS * REC_SUM_FINER / (256.0 * 100.0));
+	x[REC_KEY_HUMID]    = s->humid * (REC_SCALE_HUMID * REC_SUM_FINER / 1024.0);
+	x[REC_KEY_CPU_TEMP] = s->cpu_temp * (REC_SCALE_CPU_TEMP * REC_SUM_FINER / 1000.0);
+	x[REC_KEY_LOAD]     = s->load * (double)REC_SUM_FINER;
+}
+
+/* {"ts":..[.mmm][,"sid":..],"temp":..,"press":..,"humid":..,"cpu_temp":..,"load":..[,"loc":".."]} */
+int compose_json(char *buf, size_t buflen, const sample_t *s, const char *location)
+{
+	int64_t v[REC_KEY_LOC];
+	jsonw_t w;
+
+	rec_to_wire(s, v);
+	jw_init(&w, buf, buflen);
+	JW_LIT(&w, "{\"ts\":");
+	if (s->ts_ms) jw_fixed(&w, s->ts_ms, 3);
+	else          jw_int(&w, v[REC_KEY_TS]);
+	if (s->sid) {
+		JW_LIT(&w, ",\"sid\":");   jw_int(&w, s->sid);
+	}
+	JW_LIT(&w, ",\"temp\":");      jw_fixed(&w, v[REC_KEY_TEMP], 1);
+	JW_LIT(&w, ",\"press\":");     jw_fixed(&w, v[REC_KEY_PRESS], 1);
+	JW_LIT(&w, ",\"humid\":");     jw_fixed(&w, v[REC_KEY_HUMID], 1);
+	JW_LIT(&w, ",\"cpu_temp\":");  jw_fixed(&w, v[REC_KEY_CPU_TEMP], 1);
+	JW_LIT(&w, ",\"load\":");      jw_fixed(&w, v[REC_KEY_LOAD], 2);
+	if (location && location[0] != '\0') {
+		JW_LIT(&w, ",\"loc\":");   jw_str(&w, location);
+	}
+	jw_char(&w, '}');
+	return jw_finish(&w, buf);
+}
+
+/* Same record as compose_json(), integer keys and fixed-point values */
+int compose_cbor(char *buf, size_t buflen, const sample_t *s, const char *location)
+{
+	int has_loc = (location && location[0] != '\0');
+	int64_t v[REC_KEY_LOC];
+	cbor_writer_t w;
+
+	rec_to_wire(s, v);
+	cbor_writer_init(&w, (uint8_t *)buf, buflen);
+	cbor_put_head(&w, CBOR_MAP, REC_KEY_LOC + has_loc + (s->sid != 0) + (s->ts_ms != 0));
+	for (int k = REC_KEY_TS; k < REC_KEY_LOC; k++) {
+		cbor_put_int(&w, k);
+		cbor_put_int(&w, v[k]);
+	}
+	if (s->ts_ms) {
+		cbor_put_int(&w, REC_KEY_MS);
+		cbor_put_int(&w, s->ts_ms % 1000);
+	}
+	if (s->sid) {
+		cbor_put_int(&w, REC_KEY_SID);
+		cbor_put_int(&w, s->sid);
+	}
+	if (has_loc) {
+		cbor_put_int(&w, REC_KEY_LOC);
+		cbor_put_text(&w, location);
+	}
+	return cbor_writer_len(&w, (const uint8_t *)buf);
+}
+
+/* {0: ts[, 10: ms], 7: raw, 4: cpu_temp, 5: load[, 9: sid][, 6: loc][, 8: calib]} */
+int compose_raw(char *buf, size_t buflen, const sample_t *s, const uint8_t *raw,
+                const uint8_t *calib, const char *location)
+{
+	int has_loc = (location && location[0] != '\0');
+	int64_t v[REC_KEY_LOC];
+	cbor_writer_t w;
+
+	rec_to_wire(s, v);
+	cbor_writer_init(&w, (uint8_t *)buf, buflen);
+	cbor_put_head(&w, CBOR_MAP, 4 + has_loc + (calib != NULL) + (s->sid != 0) + (s->ts_ms != 0));
+	cbor_put_int(&w, REC_KEY_TS);       cbor_put_int(&w, v[REC_KEY_TS]);
+	if (s->ts_ms) {
+		cbor_put_int(&w, REC_KEY_MS);
+		cbor_put_int(&w, s->ts_ms % 1000);
+	}
+	cbor_put_int(&w, REC_KEY_RAW);      cbor_put_bytes(&w, raw, BME280_RAW_LEN);
+	cbor_put_int(&w, REC_KEY_CPU_TEMP); cbor_put_int(&w, v[REC_KEY_CPU_TEMP]);
+	cbor_put_int(&w, REC_KEY_LOAD);     cbor_put_int(&w, v[REC_KEY_LOAD]);
+	if (s->sid) {
+		cbor_put_int(&w, REC_KEY_SID);
+		cbor_put_int(&w, s->sid);
+	}
+	if (has_loc) {
+		cbor_put_int(&w, REC_KEY_LOC);
+		cbor_put_text(&w, location);
+	}
+	if (calib) {
+		cbor_put_int(&w, REC_KEY_CALIB);
+		cbor_put_bytes(&w, calib, BME280_CALIB_LEN);
+	}
+	return cbor_writer_len(&w, (const uint8_t *)buf);
+}
+
+int compose_calib(char *buf, size_t buflen, const uint8_t *calib, int32_t sid)
+{
+	cbor_writer_t w;
+	cbor_writer_init(&w, (uint8_t *)buf, buflen);
+	cbor_put_head(&w, CBOR_MAP, 1 + (sid != 0));
+	if (sid) {
+		cbor_put_int(&w, REC_KEY_SID);
+		cbor_put_int(&w, sid);
+	}
+	cbor_put_int(&w, REC_KEY_CALIB);
+	cbor_put_bytes(&w, calib, BME280_CALIB_LEN);
+	return cbor_writer_len(&w, (const uint8_t *)buf);
+}
+
+static const char *const sum_names[REC_KEY_LOC] = {
+	NULL, "temp", "press", "humid", "cpu_temp", "load",
+};
+/* Decimals of the summary values: one more than the plain record */
+static const int sum_decimals[REC_KEY_LOC] = { 0, 2, 2, 2, 2, 3 };
+
+/* {"ts":..[,"sid":..],"n":..,"span":..,"temp":[min,max,mean,sd],...[,"loc":".."]} */
+int compose_summary_json(char *buf, size_t buflen, const summary_t *sum, const char *location)
+{
+	jsonw_t w;
+
+	jw_init(&w, buf, buflen);
+	JW_LIT(&w, "{\"ts\":");           jw_int(&w, sum->ts);
+	if (sum->sid) {
+		JW_LIT(&w, ",\"sid\":");      jw_int(&w, sum->sid);
+	}
+	JW_LIT(&w, ",\"n\":");            jw_int(&w, sum->n);
+	JW_LIT(&w, ",\"span\":");         jw_int(&w, sum->span);
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) {
+		jw_char(&w, ',');
+		jw_str(&w, sum_names[k]);
+		JW_LIT(&w, ":[");
+		for (int i = 0; i < REC_SUM_STATS; i++) {
+			if (i) jw_char(&w, ',');
+			jw_fixed(&w, sum->v[k][i], sum_decimals[k]);
+		}
+		jw_char(&w, ']');
+	}
+	if (location && location[0] != '\0') {
+		JW_LIT(&w, ",\"loc\":");      jw_str(&w, location);
+	}
+	jw_char(&w, '}');
+	return jw_finish(&w, buf);
+}
+
+/* {0: ts, 11: n, 12: span, 1: [min, max, mean, sd], ..., 5: [...][, 9: sid][, 6: loc]} */
+int compose_summary_cbor(char *buf, size_t buflen, const summary_t *sum, const char *location)
+{
+	int has_loc = (location && location[0] != '\0');
+	cbor_writer_t w;
+
+	cbor_writer_init(&w, (uint8_t *)buf, buflen);
+	cbor_put_head(&w, CBOR_MAP, 3 + (REC_KEY_LOC - REC_KEY_TEMP) + has_loc + (sum->sid != 0));
+	cbor_put_int(&w, REC_KEY_TS);   cbor_put_int(&w, sum->ts);
+	cbor_put_int(&w, REC_KEY_N);    cbor_put_int(&w, sum->n);
+	cbor_put_int(&w, REC_KEY_SPAN); cbor_put_int(&w, sum->span);
+	for (int k = REC_KEY_TEMP; k < REC_KEY_LOC; k++) {
+		cbor_put_int(&w, k);
+		cbor_put_head(&w, CBOR_ARRAY, REC_SUM_STATS);
+		for (int i = 0; i < REC_SUM_STATS; i++) cbor_put_int(&w, sum->v[k][i]);
+	}
+	if (sum->sid) {
+		cbor_put_int(&w, REC_KEY_SID);
+		cbor_put_int(&w, sum->sid);
+	}
+	if (has_loc) {
+		cbor_put_int(&w, REC_KEY_LOC);
+		cbor_put_text(&w, location);
+	}
+	return cbor_writer_len(&w, (const uint8_t *)buf);
+}
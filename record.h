@@ -0,0 +1,125 @@
+/*
+ * record.h: bpbme280 binary record layout shared by sender and decoder.
+ *
+ * CBOR record = map with small integer keys and fixed-point integer values
+ * carrying exactly the precision of the JSON record:
+ *
+ *   key  JSON field  CBOR value
+ *   0    ts          uint, UNIX seconds
+ *   1    temp        int, 0.1 °C
+ *   2    press       int, 0.1 hPa
+ *   3    humid       int, 0.1 %RH
+ *   4    cpu_temp    int, 0.1 °C
+ *   5    load        int, 0.01
+ *   6    loc         text (optional)
+ *   9    sid         uint, sensor id (only with several sensors)
+ *   10   ms          uint, milliseconds within ts (streaming mode only;
+ *                    JSON writes "ts" with three decimals instead)
+ *
+ * A batch is an indefinite-length CBOR array of such maps.
+ *
+ * Raw record (-fraw): the sensor fields 1..3 are replaced by the unmodified
+ * ADC registers, compensated on the receiver (bme280rx.h):
+ *
+ *   7    raw         bytes(8), registers 0xF7..0xFE
+ *   8    calib       bytes(33), NVM image 0x88..0xA1 + 0xE1..0xE7
+ *
+ * Keys 0, 4, 5, 6 and 9 are as above. The calibration rides along in the
+ * first record of a session (unbatched) or as a calibration-only map
+ * {8: bytes} at the head of each batch array ({9: sid, 8: bytes} per
+ * sensor with several sensors).
+ *
+ * Summary record (-summary): statistics of each field over a window,
+ *
+ *   0    ts          uint, window start (UNIX seconds, a multiple of span)
+ *   11   n           uint, samples in the window
+ *   12   span        uint, window length in seconds
+ *   1..5             array [min, max, mean, sd] of ints, each 10x finer
+ *                    than the plain record (0.01 °C, 0.01 hPa, 0.01 %RH,
+ *                    0.01 °C, 0.001)
+ *
+ * Keys 6 and 9 are as above. JSON writes the same arrays with one more
+ * decimal than the plain record plus "n" and "span".
+ *
+ * sample_t holds one reading at full sensor precision in the fixed-point
+ * formats the datasheet compensation produces; compose_json() and
+ * compose_cbor() round it to the wire precision above.
+ */
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_KEY_TS       0
+#define REC_KEY_TEMP     1
+#define REC_KEY_PRESS    2
+#define REC_KEY_HUMID    3
+#define REC_KEY_CPU_TEMP 4
+#define REC_KEY_LOAD     5
+#define REC_KEY_LOC      6
+#define REC_KEY_RAW      7
+#define REC_KEY_CALIB    8
+#define REC_KEY_SID      9
+#define REC_KEY_MS       10
+#define REC_KEY_N        11
+#define REC_KEY_SPAN     12
+
+/* Fixed-point scale factors (value = field * scale) */
+#define REC_SCALE_TEMP     10
+#define REC_SCALE_PRESS    10
+#define REC_SCALE_HUMID    10
+#define REC_SCALE_CPU_TEMP 10
+#define REC_SCALE_LOAD     100
+/* Summary statistics are this much finer than the plain record */
+#define REC_SUM_FINER      10
+
+/* Order of the per-field summary arrays */
+#define REC_SUM_MIN   0
+#define REC_SUM_MAX   1
+#define REC_SUM_MEAN  2
+#define REC_SUM_SD    3
+#define REC_SUM_STATS 4
+
+typedef struct {
+	int64_t  ts;                 /* UNIX seconds */
+	int64_t  ts_ms;              /* UNIX milliseconds, 0 = not captured */
+	int32_t  temp;               /* 0.01 °C */
+	uint32_t press;              /* Pa, Q24.8 */
+	uint32_t humid;              /* %RH, Q22.10 */
+	int32_t  cpu_temp;           /* 0.001 °C */
+	int32_t  load;               /* 0.01 */
+	int32_t  sid;                /* sensor id, 0 = untagged (single sensor) */
+} sample_t;
+
+typedef struct {
+	int64_t  ts;                 /* window start, UNIX seconds */
+	int32_t  span;               /* window length, seconds */
+	uint32_t n;                  /* samples */
+	int32_t  sid;
+	int64_t  v[REC_KEY_LOC][REC_SUM_STATS];   /* by REC_KEY_TEMP..REC_KEY_LOAD */
+} summary_t;
+
+/* Fields at wire precision, indexed by REC_KEY_TS..REC_KEY_LOAD */
+void rec_to_wire(const sample_t *s, int64_t v[REC_KEY_LOC]);
+/* Inverse of rec_to_wire(); rec_to_wire(rec_from_wire(v)) == v */
+void rec_from_wire(const int64_t v[REC_KEY_LOC], sample_t *s);
+
+/* Fields in summary units (REC_SUM_FINER x wire precision), unrounded,
+ * indexed by REC_KEY_TEMP..REC_KEY_LOAD */
+void rec_to_summary_units(const sample_t *s, double x[REC_KEY_LOC]);
+
+/* Compact single-line JSON / CBOR record; return length or -1 if it does not fit */
+int compose_json(char *buf, size_t buflen, const sample_t *s, const char *location);
+int compose_cbor(char *buf, size_t buflen, const sample_t *s, const char *location);
+/* Raw record: ts, cpu_temp and load from s, sensor registers from raw
+ * (BME280_RAW_LEN bytes); calib (BME280_CALIB_LEN bytes) may be NULL */
+int compose_raw(char *buf, size_t buflen, const sample_t *s, const uint8_t *raw,
+                const uint8_t *calib, const char *location);
+/* Summary record, JSON or CBOR */
+int compose_summary_json(char *buf, size_t buflen, const summary_t *sum, const char *location);
+int compose_summary_cbor(char *buf, size_t buflen, const summary_t *sum, const char *location);
+/* Calibration-only map {8: calib}, or {9: sid, 8: calib} if sid != 0 */
+int compose_calib(char *buf, size_t buflen, const uint8_t *calib, int32_t sid);
+
+#endif /* RECORD_H */
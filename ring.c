@@ -0,0 +1,75 @@
+/*
+ * ring.c: Lock-free SPSC sample FIFO (see ring.h).
+ */
+
+#include <stdlib.h>
+
+#include "ring.h"
+
+int ring_init(ring_t *r, size_t cap)
+{
+	size_t n = 1;
+	while (n < cap) n <<= 1;
+	r->items = calloc(n, sizeof *r->items);
+	if (!r->items) return -1;
+	r->mask = n - 1;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->peak, 0);
+	atomic_init(&r->dropped, 0);
+	return 0;
+}
+
+void ring_free(ring_t *r)
+{
+	free(r->items);
+	r->items = NULL;
+}
+
+size_t ring_count(const ring_t *r)
+{
+	/* tail first: head only grows, so the difference never goes negative */
+	size_t t = atomic_load_explicit(&r->tail, memory_order_acquire);
+	size_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+	return h - t;
+}
+
+size_t ring_capacity(const ring_t *r)
+{
+	return r->mask + 1;
+}
+
+size_t ring_peak(const ring_t *r)
+{
+	return atomic_load_explicit(&r->peak, memory_order_relaxed);
+}
+
+uint64_t ring_dropped(const ring_t *r)
+{
+	return atomic_load_explicit(&r->dropped, memory_order_relaxed);
+}
+
+int ring_push(ring_t *r, const ring_item_t *it)
+{
+	size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t t = atomic_load_explicit(&r->tail, memory_order_acquire);
+	if (h - t > r->mask) {
+		atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+		return -1;
+	}
+	r->items[h & r->mask] = *it;
+	atomic_store_explicit(&r->head, h + 1, memory_order_release);
+	if (h + 1 - t > atomic_load_explicit(&r->peak, memory_order_relaxed))
+		atomic_store_explicit(&r->peak, h + 1 - t, memory_order_relaxed);
+	return 0;
+}
+
+int ring_pop(ring_t *r, ring_item_t *it)
+{
+	size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	size_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+	if (h == t) return -1;
+	*it = r->items[t & r->mask];
+	atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * ring.h: Lock-free single-producer/single-consumer FIFO of samples between
+ * the sampling thread and the bundle sender.
+ *
+ * Capacity is a power of two; head and tail run freely and are masked on
+ * access. Only the producer advances head and only the consumer advances
+ * tail, each publishing with a release store the other side reads with
+ * acquire, so neither side ever waits for the other. The two indexes sit
+ * on separate cache lines. A full ring rejects new samples (counted in
+ * dropped) rather than overwriting ones not yet bundled.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libbme280.h"
+#include "record.h"
+
+#define RING_CACHELINE 64
+
+typedef struct {
+	sample_t s;
+	uint8_t  raw[BME280_RAW_LEN];
+	int      tick_end;           /* last record of its sampling tick */
+} ring_item_t;
+
+typedef struct {
+	ring_item_t *items;
+	size_t       mask;               /* capacity - 1 */
+	/* Producer side */
+	_Alignas(RING_CACHELINE) atomic_size_t head;   /* next slot to write */
+	atomic_size_t     peak;          /* highest occupancy seen */
+	atomic_uint_least64_t dropped;   /* pushes rejected while full */
+	/* Consumer side */
+	_Alignas(RING_CACHELINE) atomic_size_t tail;   /* next slot to read */
+} ring_t;
+
+/* cap is rounded up to a power of two; 0 or -1 (out of memory) */
+int    ring_init(ring_t *r, size_t cap);
+void   ring_free(ring_t *r);
+/* Producer: 0, or -1 if full (the sample is dropped) */
+int    ring_push(ring_t *r, const ring_item_t *it);
+/* Consumer: 0, or -1 if empty */
+int    ring_pop(ring_t *r, ring_item_t *it);
+/* Either side; a snapshot that may be stale by the time it is used */
+size_t ring_count(const ring_t *r);
+size_t ring_capacity(const ring_t *r);
+size_t ring_peak(const ring_t *r);
+uint64_t ring_dropped(const ring_t *r);
+
+#endif /* RING_H */
@@ -0,0 +1,272 @@
+/*
+ * sensors.c: Multi-sensor, multi-bus sampling (see sensors.h).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bme280sim.h"
+#include "calcache.h"
+#include "metrics.h"
+#include "sensors.h"
+
+void sensors_init(sensors_t *ss)
+{
+	memset(ss, 0, sizeof *ss);
+	pthread_mutex_init(&ss->lock, NULL);
+	pthread_cond_init(&ss->go, NULL);
+	pthread_cond_init(&ss->done, NULL);
+}
+
+int sensors_add(sensors_t *ss, const char *dev, uint16_t addr)
+{
+	if (ss->n >= SENSORS_MAX) return -1;
+	sensor_t *s = &ss->sensor[ss->n];
+	s->dev = dev;
+	s->addr = addr;
+	s->sid = ++ss->n;
+	return 0;
+}
+
+int sensors_add_spec(sensors_t *ss, char *spec)
+{
+	char *at = strrchr(spec, '@');
+	if (!at || at == spec || at[1] == '\0') return -1;
+	if (strcmp(at + 1, "spi") == 0) {
+		*at = '\0';
+		return sensors_add(ss, spec, BME280_ADDR_SPI);
+	}
+	char *end;
+	long addr = strtol(at + 1, &end, 0);
+	if (*end != '\0' || addr < 0x03 || addr > 0x77) return -1;
+	*at = '\0';
+	return sensors_add(ss, spec, (uint16_t)addr);
+}
+
+/* Chip id, calibration and configuration of one sensor */
+static int sensor_setup(sensor_t *s, int fd, const bme280_settings_t *st, const char *cache_dir)
+{
+	/* Confirm BME280 presence (not fatal if mismatched; just warn) */
+	if (bme280_read_reg(fd, s->addr, BME280_REG_ID, &s->chip_id) < 0 || s->chip_id != BME280_CHIP_ID) {
+		fprintf(stderr, "[?] %s@0x%02X: unexpected chip-id 0x%02X (expected 0x%02X). Check wiring/address.\n",
+		        s->dev, s->addr, s->chip_id, BME280_CHIP_ID);
+	}
+
+	/* Calibration: cached copy if its key matches and one NVM register
+	 * (dig_H1 at 0xA1) agrees with the sensor, else read and re-cache */
+	uint8_t h1 = 0;
+	if (cache_dir && cache_dir[0] != '\0' &&
+	    calcache_load(cache_dir, s->dev, s->addr, s->chip_id, &s->calib, sizeof s->calib) == 0 &&
+	    bme280_read_reg(fd, s->addr, BME280_CALIB00 + 25, &h1) == 0 && h1 == s->calib.dig_H1) {
+		/* cache hit */
+	} else {
+		if (bme280_read_calib(fd, s->addr, &s->calib) < 0) {
+			fprintf(stderr, "%s@0x%02X: failed to read BME280 calibration\n", s->dev, s->addr);
+			return -1;
+		}
+		if (cache_dir && cache_dir[0] != '\0') {
+			(void)calcache_store(cache_dir, s->dev, s->addr, s->chip_id, &s->calib, sizeof s->calib);
+		}
+	}
+	bme280_pack_calib(&s->calib, s->calib_raw);
+
+	if (bme280_configure(fd, s->addr, st) < 0) {
+		fprintf(stderr, "%s@0x%02X: failed to configure BME280\n", s->dev, s->addr);
+		return -1;
+	}
+	return 0;
+}
+
+/* Status + data registers of s in one burst, repeated every poll_us (for
+ * at most limit_us) while a conversion is still running; compensated
+ * unless raw only */
+static int sensor_read(sensors_t *ss, sensor_t *s, unsigned poll_us, unsigned limit_us)
+{
+	int bursts = bme280_read_data(s->fd, s->addr, poll_us, limit_us, s->raw, NULL);
+	if (bursts < 0) return -1;
+	if (bursts > 1) metrics_add(MC_READ_RETRIES, (uint64_t)bursts - 1);
+	if (ss->compensate) {
+		int32_t t_raw, p_raw, h_raw;
+		bme280_parse_raw(s->raw, &t_raw, &p_raw, &h_raw);
+		bme280_compensate(&s->calib, t_raw, p_raw, h_raw, &s->data);
+		/* A skipped channel reads 0x80000/0x8000: report 0, not its "compensation" */
+		if (ss->settings.osrs_p == 0) s->data.press = 0;
+		if (ss->settings.osrs_h == 0) s->data.humid = 0;
+	}
+	return 0;
+}
+
+/* One tick on one bus: trigger every sensor, wait one conversion time,
+ * then read them all */
+static void bus_sample(sensors_t *ss, sensor_bus_t *b)
+{
+	const bme280_settings_t *st = &ss->settings;
+	int forced = (st->mode == BME280_MODE_FORCED);
+
+	for (int i = 0; i < b->n; i++) {
+		sensor_t *s = &ss->sensor[b->idx[i]];
+		s->ok = !forced || bme280_trigger_forced(b->fd, s->addr, st) == 0;
+	}
+
+	/* Forced: wait the maximum conversion time; a sensor still measuring
+	 * gets the same single guard wait as bme280_measure_forced(), and since
+	 * they all converted together, the others are done by then */
+	unsigned guard_us = 0;
+	int64_t t0 = metrics_now();
+	if (forced) {
+		unsigned wait_us = bme280_meas_time_us(st);
+		usleep(wait_us);
+		guard_us = wait_us / 8 + 500;
+	}
+
+	int ok = 0;
+	for (int i = 0; i < b->n; i++) {
+		sensor_t *s = &ss->sensor[b->idx[i]];
+		if (s->ok && sensor_read(ss, s, guard_us, guard_us) < 0) s->ok = 0;
+		ok += s->ok;
+	}
+	metrics_observe(MH_CONVERSION, t0);
+	metrics_add(MC_SAMPLES, (uint64_t)ok);
+	metrics_add(MC_SAMPLE_FAILURES, (uint64_t)(b->n - ok));
+}
+
+static void *bus_worker(void *arg)
+{
+	sensor_bus_t *b = arg;
+	sensors_t *ss = b->set;
+	unsigned seen = 0;
+
+	pthread_mutex_lock(&ss->lock);
+	for (;;) {
+		while (!ss->quit && ss->gen == seen) pthread_cond_wait(&ss->go, &ss->lock);
+		if (ss->quit) break;
+		seen = ss->gen;
+		pthread_mutex_unlock(&ss->lock);
+
+		bus_sample(ss, b);
+
+		pthread_mutex_lock(&ss->lock);
+		if (--ss->pending == 0) pthread_cond_signal(&ss->done);
+	}
+	pthread_mutex_unlock(&ss->lock);
+	return NULL;
+}
+
+int sensors_open(sensors_t *ss, const bme280_settings_t *st, const char *cache_dir, int compensate)
+{
+	ss->settings = *st;
+	ss->compensate = compensate;
+
+	/* Group sensors by bus, one descriptor per bus */
+	for (int i = 0; i < ss->n; i++) {
+		sensor_bus_t *b = NULL;
+		for (int k = 0; k < ss->nbus; k++) {
+			if (strcmp(ss->bus[k].dev, ss->sensor[i].dev) == 0) { b = &ss->bus[k]; break; }
+		}
+		if (!b) {
+			b = &ss->bus[ss->nbus++];
+			b->set = ss;
+			b->dev = ss->sensor[i].dev;
+			int sim = bme280sim_is_sim(b->dev);
+			b->fd = sim ? bme280sim_open(b->dev) : open(b->dev, O_RDWR | O_CLOEXEC);
+			if (b->fd < 0) {
+				fprintf(stderr, "Failed to open %s: %s\n", b->dev, strerror(errno));
+				return -1;
+			}
+			if (!sim && ss->sensor[i].addr == BME280_ADDR_SPI && bme280_spi_setup(b->fd, BME280_SPI_HZ) < 0) {
+				fprintf(stderr, "Failed to set up SPI on %s: %s\n", b->dev, strerror(errno));
+				return -1;
+			}
+		}
+		b->idx[b->n++] = i;
+		ss->sensor[i].fd = b->fd;
+		if (sensor_setup(&ss->sensor[i], b->fd, st, cache_dir) < 0) return -1;
+	}
+
+	if (st->mode == BME280_MODE_NORMAL) {
+		/* Short delay and poll status to ensure a fresh measurement */
+		int64_t t0 = metrics_now();
+		usleep(100000);
+		for (int i = 0; i < ss->n; i++) {
+			const sensor_t *s = &ss->sensor[i];
+			for (int tries = 0; tries < 5; tries++) {
+				uint8_t status = 0;
+				if (bme280_read_reg(s->fd, s->addr, BME280_REG_STATUS, &status) == 0 &&
+				    (status & BME280_STATUS_MEASURING) == 0) break;
+				usleep(20000);
+			}
+		}
+		metrics_observe(MH_SETTLE, t0);
+	}
+
+	if (ss->nbus < 2) return 0;
+
+	/* Workers leave SIGINT/SIGTERM to the main thread */
+	sigset_t block, old;
+	sigemptyset(&block);
+	sigaddset(&block, SIGINT);
+	sigaddset(&block, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &block, &old);
+	for (int k = 0; k < ss->nbus; k++) {
+		if (pthread_create(&ss->bus[k].thread, NULL, bus_worker, &ss->bus[k]) != 0) {
+			fprintf(stderr, "Failed to start worker for %s\n", ss->bus[k].dev);
+			break;
+		}
+		ss->threads++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return (ss->threads == ss->nbus) ? 0 : -1;
+}
+
+int sensors_sample(sensors_t *ss)
+{
+	if (ss->threads == 0) {
+		for (int k = 0; k < ss->nbus; k++) bus_sample(ss, &ss->bus[k]);
+	} else {
+		pthread_mutex_lock(&ss->lock);
+		ss->pending = ss->threads;
+		ss->gen++;
+		pthread_cond_broadcast(&ss->go);
+		while (ss->pending > 0) pthread_cond_wait(&ss->done, &ss->lock);
+		pthread_mutex_unlock(&ss->lock);
+	}
+
+	int ok = 0;
+	for (int i = 0; i < ss->n; i++) ok += ss->sensor[i].ok;
+	return ok;
+}
+
+/* Reading while the chip copies a finished conversion into the data
+ * registers is safe (they are shadowed), but waiting for the measuring bit
+ * to drop puts the read right after a fresh result. Status and data come
+ * in one burst, so an idle sensor costs a single transaction. */
+int sensors_read_ready(sensors_t *ss, int i)
+{
+	sensor_t *s = &ss->sensor[i];
+	int64_t t0 = metrics_now();
+	s->ok = (sensor_read(ss, s, 100, bme280_meas_time_us(&ss->settings)) == 0);
+	metrics_observe(MH_CONVERSION, t0);
+	metrics_add(s->ok ? MC_SAMPLES : MC_SAMPLE_FAILURES, 1);
+	return s->ok ? 0 : -1;
+}
+
+void sensors_close(sensors_t *ss)
+{
+	pthread_mutex_lock(&ss->lock);
+	ss->quit = 1;
+	pthread_cond_broadcast(&ss->go);
+	pthread_mutex_unlock(&ss->lock);
+	for (int k = 0; k < ss->threads; k++) pthread_join(ss->bus[k].thread, NULL);
+	ss->threads = 0;
+
+	for (int k = 0; k < ss->nbus; k++) {
+		if (ss->bus[k].fd >= 0) bme280_close(ss->bus[k].fd);
+	}
+	ss->nbus = 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * sensors.h: A set of BME280s on one or more I2C buses (or SPI chip
+ * selects), sampled together.
+ *
+ * Each sensor keeps its own calibration. Sensors are grouped by bus; with
+ * more than one bus, every bus gets a worker thread so a tick reads all
+ * buses in parallel (sensors on the same bus are triggered back to back
+ * and convert at the same time, then read one after another). A spidev
+ * node is a bus with a single sensor; a "sim..." device (bme280sim.h) is
+ * a simulated bus.
+ */
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "libbme280.h"
+
+#define SENSORS_MAX 16
+
+typedef struct {
+	const char    *dev;
+	uint16_t       addr;
+	int            sid;              /* 1..n in command-line order */
+	int            fd;               /* descriptor of its bus */
+	uint8_t        chip_id;
+	bme280_calib_t calib;
+	uint8_t        calib_raw[BME280_CALIB_LEN];   /* NVM image, for raw payloads */
+	/* Result of the last sensors_sample() */
+	int            ok;
+	bme280_data_t  data;             /* compensated (unless raw only) */
+	uint8_t        raw[BME280_RAW_LEN];
+} sensor_t;
+
+struct sensors;
+
+typedef struct {
+	struct sensors *set;         /* owning set, for the worker */
+	const char     *dev;
+	int             fd;
+	int             idx[SENSORS_MAX];    /* members, indexes into sensors_t.sensor */
+	int             n;
+	pthread_t       thread;
+} sensor_bus_t;
+
+typedef struct sensors {
+	sensor_t          sensor[SENSORS_MAX];
+	int               n;
+	sensor_bus_t      bus[SENSORS_MAX];
+	int               nbus;
+	bme280_settings_t settings;
+	int               compensate;    /* 0: keep raw bytes only */
+
+	/* Bus workers (only with nbus > 1) */
+	pthread_mutex_t   lock;
+	pthread_cond_t    go, done;
+	unsigned          gen;           /* tick number workers wait for */
+	int               pending;       /* buses still sampling this tick */
+	int               quit;
+	int               threads;       /* workers started */
+} sensors_t;
+
+void sensors_init(sensors_t *ss);
+/* Append one sensor; -1 if the set is full */
+int  sensors_add(sensors_t *ss, const char *dev, uint16_t addr);
+/* "<dev>@<addr>", e.g. "/dev/i2c-1@0x77", or "<dev>@spi" for a spidev
+ * node, e.g. "/dev/spidev0.0@spi" (addr BME280_ADDR_SPI) */
+int  sensors_add_spec(sensors_t *ss, char *spec);
+/* Open the buses, read chip ids and calibration (through the cache when
+ * cache_dir is set), configure every sensor and start the bus workers */
+int  sensors_open(sensors_t *ss, const bme280_settings_t *s, const char *cache_dir, int compensate);
+/* One measurement on every sensor; returns how many succeeded */
+int  sensors_sample(sensors_t *ss);
+/* Normal mode, one sensor: read status and data registers in one burst,
+ * repeated (for at most one conversion time) while the measuring bit is
+ * set. 0 or -1. */
+int  sensors_read_ready(sensors_t *ss, int i);
+void sensors_close(sensors_t *ss);
+
+#endif /* SENSORS_H */
@@ -0,0 +1,294 @@
+/*
+ * spill.c: Persistent payload FIFO (see spill.h).
+ *
+ * File layout (native endianness, written and read on the same host):
+ *   spill_hdr_t | entry | entry | ...
+ * An entry is { uint32 len, uint32 FNV-1a of the data } followed by the
+ * data, padded to 8 bytes. Entries live between head and tail; the header
+ * is the commit point. New entries are msync'd before the header takes
+ * them in, and a compaction's copy before the header moves to it, so the
+ * header on disk never points at data that is not. Consuming is not
+ * synced: after a power loss an entry may come back, but none is lost.
+ * The file grows by doubling up to the size limit and is compacted when
+ * the consumed space in front can take the live entries without overlap.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spill.h"
+
+#define SPILL_MAGIC      0x50535042u  /* "BPSP" */
+#define SPILL_VERSION    2            /* 2: bpbme280 entries start with a destination */
+#define SPILL_INIT_BYTES (64u << 10)
+#define SPILL_ALIGN      8
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t head;               /* offset of the oldest entry */
+	uint64_t tail;               /* offset just past the newest entry */
+	uint64_t count;
+} spill_hdr_t;
+
+typedef struct {
+	uint32_t len;
+	uint32_t sum;
+} spill_ent_t;
+
+#define SPILL_DATA sizeof(spill_hdr_t)
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static size_t ent_size(size_t len)
+{
+	return (sizeof(spill_ent_t) + len + SPILL_ALIGN - 1) & ~(size_t)(SPILL_ALIGN - 1);
+}
+
+static spill_hdr_t *hdr_of(const spill_t *sp)
+{
+	return (spill_hdr_t *)sp->map;
+}
+
+static void spill_reset(spill_t *sp)
+{
+	spill_hdr_t *h = hdr_of(sp);
+	h->head = h->tail = SPILL_DATA;
+	h->count = 0;
+	sp->tail = SPILL_DATA;
+	sp->count = 0;
+}
+
+/* Keep the intact entries from head on; stop at the first torn one */
+static void spill_recover(spill_t *sp)
+{
+	spill_hdr_t *h = hdr_of(sp);
+	if (h->head < SPILL_DATA || h->head > h->tail || h->tail > sp->size) {
+		spill_reset(sp);
+		return;
+	}
+	uint64_t off = h->head, n = 0;
+	while (off + sizeof(spill_ent_t) <= h->tail) {
+		const spill_ent_t *e = (const spill_ent_t *)(sp->map + off);
+		if (off + ent_size(e->len) > h->tail ||
+		    e->sum != fnv1a(2166136261u, e + 1, e->len)) break;
+		off += ent_size(e->len);
+		n++;
+	}
+	h->tail = off;
+	h->count = n;
+	sp->tail = off;
+	sp->count = n;
+	if (n == 0) spill_reset(sp);
+}
+
+/* The directory of path, one level, like the calibration cache */
+static void spill_mkdir(const char *path)
+{
+	char dir[256];
+	const char *slash = strrchr(path, '/');
+	if (!slash || slash == path || (size_t)(slash - path) >= sizeof dir) return;
+	memcpy(dir, path, slash - path);
+	dir[slash - path] = '\0';
+	(void)mkdir(dir, 0755);
+}
+
+int spill_open(spill_t *sp, const char *path, size_t max_bytes)
+{
+	struct stat st;
+	int err;
+
+	memset(sp, 0, sizeof *sp);
+	sp->fd = -1;
+	sp->max = max_bytes;
+	spill_mkdir(path);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) return -1;
+	if (flock(fd, LOCK_EX | LOCK_NB) < 0 || fstat(fd, &st) < 0) goto fail;
+
+	int fresh = ((size_t)st.st_size < SPILL_INIT_BYTES);
+	if (!fresh) {
+		spill_hdr_t h;
+		fresh = pread(fd, &h, sizeof h, 0) != (ssize_t)sizeof h ||
+		        h.magic != SPILL_MAGIC || h.version != SPILL_VERSION;
+	}
+	sp->size = fresh ? SPILL_INIT_BYTES : (size_t)st.st_size;
+	if (fresh && ftruncate(fd, (off_t)sp->size) < 0) goto fail;
+
+	sp->map = mmap(NULL, sp->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (sp->map == MAP_FAILED) {
+		sp->map = NULL;
+		goto fail;
+	}
+	sp->fd = fd;
+	if (fresh) {
+		spill_hdr_t *h = hdr_of(sp);
+		memset(h, 0, sizeof *h);
+		h->magic = SPILL_MAGIC;
+		h->version = SPILL_VERSION;
+		spill_reset(sp);
+	} else {
+		spill_recover(sp);
+	}
+	if (sp->max < sp->size) sp->max = sp->size;
+	return 0;
+
+fail:
+	err = errno;                        /* EWOULDBLOCK: locked elsewhere */
+	close(fd);
+	errno = err;
+	return -1;
+}
+
+void spill_close(spill_t *sp)
+{
+	if (sp->map) {
+		(void)spill_sync(sp);
+		(void)msync(sp->map, sp->size, MS_SYNC);
+		munmap(sp->map, sp->size);
+		sp->map = NULL;
+	}
+	if (sp->fd >= 0) close(sp->fd);
+	sp->fd = -1;
+}
+
+/* Room for need more bytes at tail: rewind, compact or grow */
+static int spill_reserve(spill_t *sp, size_t need)
+{
+	spill_hdr_t *h = hdr_of(sp);
+	if (sp->tail + need <= sp->size) return 0;
+	if (sp->count == 0) {
+		spill_reset(sp);
+		if (SPILL_DATA + need <= sp->size) return 0;
+	}
+
+	/* Only committed entries are moved */
+	if (spill_sync(sp) < 0) return -1;
+	size_t live = h->tail - h->head;
+	if (h->head - SPILL_DATA >= live && SPILL_DATA + live + need <= sp->size) {
+		/* No overlap: the old copy stays valid until the header moves,
+		 * which it does only once the new one is on disk; the header in
+		 * turn is on disk before the old copy is overwritten */
+		memcpy(sp->map + SPILL_DATA, sp->map + h->head, live);
+		if (msync(sp->map, SPILL_DATA + live, MS_SYNC) < 0) return -1;
+		h->head = SPILL_DATA;
+		h->tail = SPILL_DATA + live;
+		sp->tail = h->tail;
+		return msync(sp->map, SPILL_DATA, MS_SYNC);
+	}
+
+	size_t size = sp->size;
+	while (size < sp->tail + need && size < sp->max) size *= 2;
+	if (size > sp->max) size = sp->max;
+	if (size < sp->tail + need) return -1;
+	if (ftruncate(sp->fd, (off_t)size) < 0) return -1;
+	uint8_t *map = mremap(sp->map, sp->size, size, MREMAP_MAYMOVE);
+	if (map == MAP_FAILED) return -1;
+	sp->map = map;
+	sp->size = size;
+	return 0;
+}
+
+int spill_append(spill_t *sp, const void *buf, size_t len)
+{
+	struct iovec iov = { (void *)buf, len };
+	return spill_appendv(sp, &iov, 1);
+}
+
+int spill_appendv(spill_t *sp, const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+	if (len > UINT32_MAX || spill_reserve(sp, ent_size(len)) < 0) return -1;
+
+	spill_ent_t *e = (spill_ent_t *)(sp->map + sp->tail);
+	uint8_t *p = (uint8_t *)(e + 1);
+	uint32_t sum = 2166136261u;
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		sum = fnv1a(sum, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+	e->len = (uint32_t)len;
+	e->sum = sum;
+	sp->tail += ent_size(len);
+	sp->count++;
+	return 0;
+}
+
+int spill_sync(spill_t *sp)
+{
+	spill_hdr_t *h = hdr_of(sp);
+	if (sp->tail == h->tail) return 0;
+
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t from = (size_t)h->tail & ~(page - 1);
+	if (msync(sp->map + from, sp->tail - from, MS_SYNC) < 0) return -1;
+	h->tail = sp->tail;
+	h->count = sp->count;
+	return msync(sp->map, SPILL_DATA, MS_SYNC);
+}
+
+int spill_peek(const spill_t *sp, const uint8_t **buf, size_t *len)
+{
+	const spill_hdr_t *h = hdr_of(sp);
+	if (h->count == 0) return -1;
+	const spill_ent_t *e = (const spill_ent_t *)(sp->map + h->head);
+	*buf = (const uint8_t *)(e + 1);
+	*len = e->len;
+	return 0;
+}
+
+void spill_consume(spill_t *sp)
+{
+	spill_hdr_t *h = hdr_of(sp);
+	if (h->count == 0) return;
+	const spill_ent_t *e = (const spill_ent_t *)(sp->map + h->head);
+	h->head += ent_size(e->len);
+	h->count--;
+	if (--sp->count == 0) spill_reset(sp);
+}
+
+int spill_read(const spill_t *sp, size_t *pos, const uint8_t **buf, size_t *len)
+{
+	const spill_hdr_t *h = hdr_of(sp);
+	if (*pos < h->head) *pos = h->head;
+	if (h->count == 0 || *pos >= h->tail) return -1;
+	const spill_ent_t *e = (const spill_ent_t *)(sp->map + *pos);
+	*buf = (const uint8_t *)(e + 1);
+	*len = e->len;
+	*pos += ent_size(e->len);
+	return 0;
+}
+
+void spill_consume_to(spill_t *sp, size_t pos)
+{
+	while (hdr_of(sp)->count > 0 && hdr_of(sp)->head < pos) spill_consume(sp);
+}
+
+size_t spill_count(const spill_t *sp)
+{
+	return (size_t)hdr_of(sp)->count;
+}
+
+size_t spill_bytes(const spill_t *sp)
+{
+	const spill_hdr_t *h = hdr_of(sp);
+	return (size_t)(h->tail - h->head);
+}
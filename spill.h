@@ -0,0 +1,54 @@
+/*
+ * spill.h: Persistent FIFO of byte records in a memory-mapped file.
+ *
+ * Used twice by bpbme280: bundle payloads that find no ZCO/SDR space go
+ * here instead of blocking or being lost and are replayed oldest first once
+ * ION has room again, and samples taken while BP cannot be attached are
+ * journaled here until it can. The file survives restarts; entries carry a
+ * checksum and reopening keeps the intact prefix of a queue cut short by a
+ * crash or power loss. An open file is locked (flock), so two processes
+ * never share one.
+ */
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define SPILL_DEFAULT_FILE "/var/cache/bpbme280/spill"
+#define SPILL_MAX_BYTES    (16u << 20)
+
+typedef struct {
+	int      fd;
+	uint8_t *map;                /* header + entries */
+	size_t   size;               /* current file (and mapping) size */
+	size_t   max;                /* file size limit */
+	uint64_t tail;               /* appended up to here; the header follows at spill_sync() */
+	uint64_t count;              /* entries up to tail */
+} spill_t;
+
+/* Open or create the file (its directory too) and lock it. Returns 0, or
+ * -1 (errno EWOULDBLOCK: another process has it open). */
+int    spill_open(spill_t *sp, const char *path, size_t max_bytes);
+void   spill_close(spill_t *sp);
+/* Queue a copy of buf; -1 if the file is full or cannot grow. The entry
+ * is queued (seen by peek and count) once spill_sync() commits it. */
+int    spill_append(spill_t *sp, const void *buf, size_t len);
+/* The same, one entry from iovcnt pieces */
+int    spill_appendv(spill_t *sp, const struct iovec *iov, int iovcnt);
+/* Write the appended entries to disk, then the header that takes them in.
+ * 0 or -1. */
+int    spill_sync(spill_t *sp);
+/* Oldest entry, in place (valid until the next append or consume); -1 if empty */
+int    spill_peek(const spill_t *sp, const uint8_t **buf, size_t *len);
+void   spill_consume(spill_t *sp);
+/* Entry at *pos (0: the oldest), in place, and *pos moved past it; -1
+ * after the newest. Positions stay valid until the next append. */
+int    spill_read(const spill_t *sp, size_t *pos, const uint8_t **buf, size_t *len);
+/* Consume the entries in front of pos */
+void   spill_consume_to(spill_t *sp, size_t pos);
+size_t spill_count(const spill_t *sp);
+size_t spill_bytes(const spill_t *sp);
+
+#endif /* SPILL_H */
@@ -0,0 +1,80 @@
+/*
+ * test_deadband.c: Dead-band staging and commit (deadband.h), with journal
+ * records replayed after newer live readings have gone out.
+ *
+ * Usage:
+ *   test/test_deadband          (exit status 0 if every check passes)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+
+#include "../deadband.h"
+
+static int failed;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { fprintf(stderr, "test_deadband:%d: %s\n", __LINE__, #cond); failed++; } \
+} while (0)
+
+static sample_t reading(int64_t ts, int32_t temp)
+{
+	sample_t s;
+	memset(&s, 0, sizeof s);
+	s.ts = ts;
+	s.temp = temp;
+	return s;
+}
+
+/* deadband_check(), then stage and commit as a bundle that went out */
+static int send(deadband_t *db, int64_t ts, int32_t temp, int replay)
+{
+	sample_t s = reading(ts, temp);
+	if (!deadband_check(db, &s, replay)) return 0;
+	deadband_stage(db, &s, replay);
+	deadband_commit(db);
+	return 1;
+}
+
+int main(void)
+{
+	static deadband_t db;
+
+	CHECK(deadband_parse(&db, "0.5") == 0);
+	db.heartbeat = 3600;
+	CHECK(deadband_open(&db, NULL, "ipn:2.1") == 0);
+
+	/* Live readings: the first goes out, a small move does not */
+	CHECK(send(&db, 1000, 2000, 0) == 1);
+	CHECK(send(&db, 1010, 2020, 0) == 0);
+
+	/* Journal records older than the last live send: held to the
+	 * thresholds, and never moving the state back */
+	CHECK(send(&db, 900, 2010, 1) == 0);
+	CHECK(send(&db, 901, 2500, 1) == 1);
+	CHECK(db.last[0].ts == 1000);
+	CHECK(send(&db, 1020, 2030, 0) == 0);    /* still compared with 20.00 °C */
+	CHECK(send(&db, 1030, 2060, 0) == 1);
+	CHECK(db.last[0].ts == 1030);
+
+	/* A replayed record newer than the state is staged as usual */
+	CHECK(send(&db, 1040, 2200, 1) == 1);
+	CHECK(db.last[0].ts == 1040);
+
+	/* Staged but not sent: rolled back, the state stays */
+	sample_t s = reading(1050, 3000);
+	CHECK(deadband_check(&db, &s, 1) == 1);
+	deadband_stage(&db, &s, 1);
+	deadband_rollback(&db);
+	CHECK(db.last[0].ts == 1040 && db.pend[0].ts == 1040);
+
+	/* A live reading from before the state: the clock went back */
+	CHECK(send(&db, 500, 2200, 0) == 1);
+	CHECK(db.last[0].ts == 500);
+
+	deadband_close(&db);
+	if (failed) return 1;
+	printf("test_deadband: ok\n");
+	return 0;
+}
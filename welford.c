@@ -0,0 +1,29 @@
+/*
+ * welford.c: Welford running statistics (see welford.h).
+ */
+
+#include <math.h>
+
+#include "welford.h"
+
+void welford_init(welford_t *w)
+{
+	w->n = 0;
+	w->mean = w->m2 = 0.0;
+	w->min = w->max = 0.0;
+}
+
+void welford_add(welford_t *w, double x)
+{
+	w->n++;
+	double d = x - w->mean;
+	w->mean += d / (double)w->n;
+	w->m2 += d * (x - w->mean);
+	if (w->n == 1 || x < w->min) w->min = x;
+	if (w->n == 1 || x > w->max) w->max = x;
+}
+
+double welford_sd(const welford_t *w)
+{
+	return (w->n > 1) ? sqrt(w->m2 / (double)(w->n - 1)) : 0.0;
+}
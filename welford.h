@@ -0,0 +1,25 @@
+/*
+ * welford.h: Incremental statistics over a window of samples.
+ *
+ * Welford's update keeps count, running mean and the sum of squared
+ * deviations, so min/max/mean/standard deviation of any number of samples
+ * take O(1) memory and stay accurate where sum/sum-of-squares would cancel.
+ */
+#ifndef WELFORD_H
+#define WELFORD_H
+
+#include <stdint.h>
+
+typedef struct {
+	uint64_t n;
+	double   mean;
+	double   m2;                 /* sum of squared deviations from the mean */
+	double   min, max;
+} welford_t;
+
+void   welford_init(welford_t *w);
+void   welford_add(welford_t *w, double x);
+/* Sample standard deviation (n - 1); 0 below two values */
+double welford_sd(const welford_t *w);
+
+#endif /* WELFORD_H */